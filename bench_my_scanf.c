@@ -0,0 +1,520 @@
+// Leora Konig
+// COMP 2113 Final Project -- my_scanf benchmarks
+//
+// Each case writes a generated input file, redirects stdin to it and times a
+// scan loop over the whole file with my_scanf, then with a reference: libc
+// scanf, or for %T / %I my_scanf with the equivalent chain of %d's.
+// Compressed cases read a packed copy through the line iterator's
+// decompression stage, against a gzip -dc pipe or the plain file.
+// Throughput is reported in MB/s of input consumed.
+//
+//   bench_my_scanf                     table of results
+//   bench_my_scanf --json              the same results as JSON
+//   bench_my_scanf --compare FILE      also check against a --json baseline;
+//                                      exits 1 if any case's speedup over its
+//                                      reference dropped by more than
+//                                      --threshold percent (default 25), or
+//                                      if the two sides read different counts
+//   --repeat N                         keep the best of N timings per case
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "my_scanf.h"
+#ifdef MY_SCANF_ZLIB
+#include <zlib.h>
+#endif
+
+#define BENCH_FILE "bench_input.txt"
+#define BENCH_PACKED "bench_input.packed"
+#define BENCH_COLUMNS "bench_input.columns"
+#define BENCH_VALUES 1000000
+
+/* =========================
+   INPUT GENERATORS
+   ========================= */
+static unsigned long long rng_state = 88172645463325252ULL;
+
+// xorshift64: deterministic, so every run scans the same bytes.
+static unsigned long long next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+void gen_ints(FILE *out) {
+    for (int i = 0; i < BENCH_VALUES; i++)
+        fprintf(out, "%d\n", (int)next_random());
+}
+
+void gen_records(FILE *out) {
+    for (int i = 0; i < BENCH_VALUES; i++)
+        fprintf(out, "%d %.3f item%u\n", (int)next_random(),
+                (double)(next_random() % 2000000) / 1000.0, (unsigned)(next_random() % 100000));
+}
+
+void gen_hex(FILE *out) {
+    for (int i = 0; i < BENCH_VALUES; i++)
+        fprintf(out, "%x\n", (unsigned)next_random());
+}
+
+void gen_floats(FILE *out) {
+    for (int i = 0; i < BENCH_VALUES; i++)
+        fprintf(out, "%.6f\n", (double)(next_random() % 2000000) / 1000.0 - 1000.0);
+}
+
+void gen_words(FILE *out) {
+    for (int i = 0; i < BENCH_VALUES; i++) {
+        int len = 3 + (int)(next_random() % 12);
+        for (int j = 0; j < len; j++) fputc('a' + (int)(next_random() % 26), out);
+        fputc(i % 8 == 7 ? '\n' : ' ', out);
+    }
+}
+
+void gen_timestamps(FILE *out) {
+    for (int i = 0; i < BENCH_VALUES; i++) {
+        unsigned long long r = next_random();
+        fprintf(out, "%04d-%02d-%02dT%02d:%02d:%02dZ\n", 1970 + (int)(r % 100), 1 + (int)(r >> 8 & 0xFF) % 12,
+                1 + (int)(r >> 16 & 0xFF) % 28, (int)(r >> 24 & 0xFF) % 24, (int)(r >> 32 & 0xFF) % 60,
+                (int)(r >> 40 & 0xFF) % 60);
+    }
+}
+
+void gen_ipv4(FILE *out) {
+    for (int i = 0; i < BENCH_VALUES; i++) {
+        unsigned r = (unsigned)next_random();
+        fprintf(out, "%u.%u.%u.%u\n", r >> 24, r >> 16 & 0xFF, r >> 8 & 0xFF, r & 0xFF);
+    }
+}
+
+// Long fields (1-8 KiB) followed by a number, for the suppressed-field cases.
+void gen_long_fields(FILE *out) {
+    for (int i = 0; i < BENCH_VALUES / 100; i++) {
+        int len = 1024 + (int)(next_random() % 7168);
+        for (int j = 0; j < len; j++) fputc('a' + (int)(next_random() % 26), out);
+        fprintf(out, ",%d\n", (int)(next_random() % 1000));
+    }
+}
+
+/* =========================
+   TIMING
+   ========================= */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Runs `fmt` against the bench file until a record stops matching all
+// `fields` conversions. With `lines` set, my_scanf's side goes through the
+// line iterator instead. Returns elapsed seconds; *count receives the number
+// of records read.
+static double time_scan(const char *fmt, int fields, int use_libc, int lines, long *count) {
+    union { long long i; double d; char s[256]; } v[6];  // Fits every conversion benchmarked here
+    long n = 0;
+
+    freopen(BENCH_FILE, "r", stdin);
+    my_scanf_reset();
+    double start = now_seconds();
+    if (use_libc) while (scanf(fmt, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) == fields) n++;
+    else if (lines) {
+        my_scanf_lines *it = my_scanf_lines_open(stdin);
+        int r;
+        while ((r = my_scanf_lines_next(it, fmt, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5])) != EOF)
+            n += (r == fields);
+        my_scanf_lines_close(it);
+    }
+    else          while (my_scanf(fmt, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) == fields) n++;
+    double elapsed = now_seconds() - start;
+
+    *count = n;
+    return elapsed;
+}
+
+/* =========================
+   CASES
+   ========================= */
+typedef struct {
+    const char *name;
+    const char *format;
+    void (*generate)(FILE *out);
+    int lines;              // Scan with my_scanf_lines_next
+    const char *reference;  // my_scanf format to compare against instead of libc
+    int fields;             // Conversions per record in `reference`
+} bench_case;
+
+static const bench_case cases[] = {
+    { "int %d", "%d", gen_ints },
+    { "hex %x", "%x", gen_hex  },
+    { "float %lf", "%lf", gen_floats },
+    { "string %s", "%255s", gen_words },
+    { "lines %d", "%d", gen_ints, 1 },
+    { "time %T", "%T", gen_timestamps, 0, "%d-%d-%dT%d:%d:%dZ", 6 },
+    { "lines %T", "%T", gen_timestamps, 1, "%d-%d-%dT%d:%d:%dZ", 6 },
+    { "ipv4 %I", "%I", gen_ipv4, 0, "%d.%d.%d.%d", 4 },
+    { "lines %I", "%I", gen_ipv4, 1, "%d.%d.%d.%d", 4 },
+    { "skip %*[", "%*[^,],%d", gen_long_fields },
+    { "skip lines", "%*[^,],%d", gen_long_fields, 1 },
+};
+
+// Measured throughput of one case.
+typedef struct {
+    char name[32];
+    const char *label, *ref_label;  // What was timed on each side
+    double mine, ref;               // MB/s
+    long count;                     // Values read by the measured side
+    int mismatch;                   // The two sides read different counts
+} bench_result;
+
+static bench_result results[32];
+static int result_count;
+static int repeat = 1;
+
+static long write_input(void (*generate)(FILE *out)) {
+    FILE *out = fopen(BENCH_FILE, "w");
+    if (!out) { perror("fopen"); exit(1); }
+    generate(out);
+    long bytes = ftell(out);
+    fclose(out);
+    return bytes;
+}
+
+static void run_case(const bench_case *bc) {
+    long bytes = write_input(bc->generate);
+    long mine_n = 0, ref_n = 0;
+    double mine = 1e30, ref = 1e30;
+
+    for (int r = 0; r < repeat; r++) {
+        double t = time_scan(bc->format, 1, 0, bc->lines, &mine_n);
+        if (t < mine) mine = t;
+        t = bc->reference ? time_scan(bc->reference, bc->fields, 0, bc->lines, &ref_n)
+                          : time_scan(bc->format, 1, 1, 0, &ref_n);
+        if (t < ref) ref = t;
+    }
+
+    bench_result *res = &results[result_count++];
+    snprintf(res->name, sizeof(res->name), "%s", bc->name);
+    res->label = "my_scanf";
+    res->ref_label = bc->reference ? "multi-%d" : "libc";
+    res->mine = bytes / 1e6 / mine;
+    res->ref = bytes / 1e6 / ref;
+    res->count = mine_n;
+    res->mismatch = mine_n != ref_n;
+}
+
+/* =========================
+   BULK
+   ========================= */
+// Times my_scan_int64s / my_scan_doubles over the whole bench file,
+// against the equivalent my_scanf loop.
+static void run_bulk(const char *name, void (*generate)(FILE *out), int doubles, int threads) {
+    long bytes = write_input(generate);
+    size_t n = 0;
+    long loop_n = 0;
+    double bulk = 1e30, loop = 1e30;
+
+    for (int r = 0; r < repeat; r++) {
+        void *values = NULL;
+        size_t cap = 0;
+        FILE *in = fopen(BENCH_FILE, "r");
+        my_scan_set_threads(threads);
+        double start = now_seconds();
+        n = doubles ? my_scan_doubles(in, (double **)&values, &cap, 0)
+                    : my_scan_int64s(in, (long long **)&values, &cap, 0);
+        double t = now_seconds() - start;
+        if (t < bulk) bulk = t;
+        my_scan_set_threads(1);
+        fclose(in);
+        free(values);
+
+        t = time_scan(doubles ? "%lf" : "%lld", 1, 0, 0, &loop_n);
+        if (t < loop) loop = t;
+    }
+
+    bench_result *res = &results[result_count++];
+    snprintf(res->name, sizeof(res->name), "%s", name);
+    res->label = "my_scan";
+    res->ref_label = "my_scanf";
+    res->mine = bytes / 1e6 / bulk;
+    res->ref = bytes / 1e6 / loop;
+    res->count = (long)n;
+    res->mismatch = (long)n != loop_n;
+}
+
+/* =========================
+   COMPRESSED INPUT
+   ========================= */
+// Lines of integers read from a compressed copy of the bench file through
+// the iterator's decompression stage, against `reference`: the line
+// iterator over the output of a decompression command, or over the plain
+// file when the command is NULL. Throughput is in decompressed MB/s.
+static double time_packed(int codec, int overlap, const char *command, long *count) {
+    long long v;
+    long n = 0;
+    double start = now_seconds();
+    FILE *in = command ? popen(command, "r") : fopen(codec < 0 ? BENCH_FILE : BENCH_PACKED, "r");
+    my_scanf_lines *it = my_scanf_lines_open_codec(in, codec < 0 ? MY_SCANF_RAW : codec, overlap);
+    while (my_scanf_lines_next(it, "%lld", &v) != EOF) n++;
+    my_scanf_lines_close(it);
+    if (command) pclose(in);
+    else fclose(in);
+    *count = n;
+    return now_seconds() - start;
+}
+
+static void run_packed(const char *name, int codec, int overlap, const char *command) {
+    long bytes = write_input(gen_ints);
+    FILE *in = fopen(BENCH_FILE, "rb");
+    char *raw = malloc(bytes);
+    if (!raw || fread(raw, 1, bytes, in) != (size_t)bytes) { perror("read"); exit(1); }
+    fclose(in);
+    if (codec == MY_SCANF_LZ) {
+        FILE *out = fopen(BENCH_PACKED, "wb");
+        my_scanf_lz_write(out, raw, bytes);
+        fclose(out);
+    } else {
+#ifdef MY_SCANF_ZLIB
+        gzFile out = gzopen(BENCH_PACKED, "wb6");
+        gzwrite(out, raw, (unsigned)bytes);
+        gzclose(out);
+#endif
+    }
+    free(raw);
+
+    long mine_n = 0, ref_n = 0;
+    double mine = 1e30, ref = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        double t = time_packed(codec, overlap, NULL, &mine_n);
+        if (t < mine) mine = t;
+        t = time_packed(-1, 0, command, &ref_n);
+        if (t < ref) ref = t;
+    }
+    remove(BENCH_PACKED);
+
+    bench_result *res = &results[result_count++];
+    snprintf(res->name, sizeof(res->name), "%s", name);
+    res->label = overlap ? "overlap" : "inline";
+    res->ref_label = command ? "pipe" : "plain";
+    res->mine = bytes / 1e6 / mine;
+    res->ref = bytes / 1e6 / ref;
+    res->count = mine_n;
+    res->mismatch = mine_n != ref_n;
+}
+
+/* =========================
+   COLUMNAR SINK
+   ========================= */
+// Converts "int double word" records to a columnar file: straight into the
+// sink's columns, or (the reference) scanned into locals by the line
+// iterator and appended to column arrays in a second step, then written.
+static double time_sink(int direct, long *count) {
+    double start = now_seconds();
+    FILE *in = fopen(BENCH_FILE, "r");
+    FILE *out = fopen(BENCH_COLUMNS, "wb");
+    my_scanf_lines *it = my_scanf_lines_open(in);
+    long n = 0;
+    if (direct) {
+        my_scanf_sink *sink = my_scanf_sink_open("%lld %lf %s");
+        n = (long)my_scanf_sink_lines(sink, it);
+        my_scanf_sink_write(sink, out);
+        my_scanf_sink_close(sink);
+    } else {
+        long long id, *ids = NULL;
+        double x, *xs = NULL;
+        char word[256], *words = NULL;
+        size_t cap = 0, used = 0, words_cap = 0;
+        while (my_scanf_lines_next(it, "%lld %lf %255s", &id, &x, word) != EOF) {
+            size_t len = strlen(word);
+            if ((size_t)n == cap) {
+                cap = cap ? cap * 2 : 4096;
+                ids = realloc(ids, cap * sizeof(*ids));
+                xs = realloc(xs, cap * sizeof(*xs));
+            }
+            if (used + len > words_cap) {
+                words_cap = words_cap ? words_cap * 2 : 65536;
+                words = realloc(words, words_cap);
+            }
+            ids[n] = id;
+            xs[n++] = x;
+            memcpy(words + used, word, len);
+            used += len;
+        }
+        fwrite(ids, sizeof(*ids), n, out);
+        fwrite(xs, sizeof(*xs), n, out);
+        fwrite(words, 1, used, out);
+        free(ids);
+        free(xs);
+        free(words);
+    }
+    my_scanf_lines_close(it);
+    fclose(in);
+    fclose(out);
+    *count = n;
+    return now_seconds() - start;
+}
+
+static void run_sink(const char *name) {
+    long bytes = write_input(gen_records);
+    long mine_n = 0, ref_n = 0;
+    double mine = 1e30, ref = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        double t = time_sink(1, &mine_n);
+        if (t < mine) mine = t;
+        t = time_sink(0, &ref_n);
+        if (t < ref) ref = t;
+    }
+    remove(BENCH_COLUMNS);
+
+    bench_result *res = &results[result_count++];
+    snprintf(res->name, sizeof(res->name), "%s", name);
+    res->label = "sink";
+    res->ref_label = "copy";
+    res->mine = bytes / 1e6 / mine;
+    res->ref = bytes / 1e6 / ref;
+    res->count = mine_n;
+    res->mismatch = mine_n != ref_n;
+}
+
+/* =========================
+   REPORTING
+   ========================= */
+static void print_table(void) {
+    for (int i = 0; i < result_count; i++) {
+        const bench_result *res = &results[i];
+        printf("%-14s %-8s %8.1f MB/s   %-8s %8.1f MB/s   (%ld values%s)\n",
+               res->name, res->label, res->mine, res->ref_label, res->ref, res->count,
+               res->mismatch ? ", COUNT MISMATCH" : "");
+    }
+}
+
+// One case per line, so baselines diff cleanly and compare_baseline can
+// read them back line by line.
+static void print_json(long peak_rss) {
+    const my_scanf_stats *st = my_scanf_get_stats();
+    printf("{\n  \"peak_rss_kib\": %ld,\n", peak_rss);
+    printf("  \"fast_paths\": {\"fast\": %llu, \"fallback\": %llu, \"general\": %llu, \"demotions\": %llu},\n",
+           st->fast, st->fallback, st->general, st->demotions);
+    printf("  \"cases\": [\n");
+    for (int i = 0; i < result_count; i++) {
+        const bench_result *res = &results[i];
+        printf("    {\"name\": \"%s\", \"mbps\": %.1f, \"reference\": \"%s\", \"reference_mbps\": %.1f, "
+               "\"values\": %ld, \"mismatch\": %d}%s\n",
+               res->name, res->mine, res->ref_label, res->ref, res->count, res->mismatch,
+               i + 1 < result_count ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+// Checks each case against the entry with the same name in a baseline
+// written by --json. Absolute MB/s moves with the machine and its load, so
+// what is compared is the speedup over the reference timed in the same run
+// (mbps / reference_mbps). A case whose two sides read different counts
+// fails regardless. Returns the number of failures (1 if the baseline
+// cannot be used).
+static int compare_baseline(const char *path, double threshold) {
+    FILE *in = fopen(path, "r");
+    if (!in) { perror(path); return 1; }
+
+    char line[512];
+    int failures = 0, matched = 0;
+    int found[sizeof(results) / sizeof(results[0])] = {0};
+    while (fgets(line, sizeof(line), in)) {
+        char name[32];
+        double base, base_ref;
+        const char *field = strstr(line, "\"name\": \"");
+        const char *mbps = strstr(line, "\"mbps\": ");
+        const char *ref = strstr(line, "\"reference_mbps\": ");
+        if (!field || !mbps || !ref || my_sscanf(field + 9, "%31[^\"]", name) != 1 ||
+            my_sscanf(mbps + 8, "%lf", &base) != 1 || my_sscanf(ref + 18, "%lf", &base_ref) != 1 ||
+            base <= 0 || base_ref <= 0)
+            continue;
+
+        for (int i = 0; i < result_count; i++) {
+            const bench_result *res = &results[i];
+            if (strcmp(res->name, name) != 0 || found[i]) continue;
+            double before = base / base_ref, after = res->mine / res->ref;
+            double change = (after - before) / before * 100;
+            int slower = change < -threshold;
+            fprintf(stderr, "%-14s %6.2fx -> %6.2fx vs %-8s  %+6.1f%%%s%s\n", name, before, after,
+                    res->ref_label, change, slower ? "  REGRESSION" : "",
+                    res->mismatch ? "  COUNT MISMATCH" : "");
+            failures += slower || res->mismatch;
+            found[i] = 1;
+            matched++;
+            break;
+        }
+    }
+    fclose(in);
+    if (matched == 0) {
+        fprintf(stderr, "%s: no cases in common with this run\n", path);
+        return 1;
+    }
+    for (int i = 0; i < result_count; i++) {
+        if (found[i]) continue;
+        fprintf(stderr, "%-14s not in baseline%s\n", results[i].name, results[i].mismatch ? "  COUNT MISMATCH" : "");
+        failures += results[i].mismatch;
+    }
+    return failures;
+}
+
+/* =========================
+   MAIN
+   ========================= */
+int main(int argc, char **argv) {
+    const char *baseline = NULL;
+    double threshold = 25;
+    int json = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) json = 1;
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) baseline = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--json] [--compare baseline.json] [--threshold pct] [--repeat n]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (repeat < 1) repeat = 1;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        run_case(&cases[i]);
+    run_bulk("bulk int64", gen_ints, 0, 1);
+    run_bulk("bulk double", gen_floats, 1, 1);
+#ifdef MY_SCANF_THREADS
+    run_bulk("bulk int64 x4", gen_ints, 0, 4);
+#endif
+    run_packed("lines lz", MY_SCANF_LZ, 0, NULL);
+#ifdef MY_SCANF_ZLIB
+    run_packed("lines gzip", MY_SCANF_GZIP, 0, "gzip -dc " BENCH_PACKED);
+#endif
+#ifdef MY_SCANF_THREADS
+    run_packed("lz overlap", MY_SCANF_LZ, 1, NULL);
+#ifdef MY_SCANF_ZLIB
+    run_packed("gzip overlap", MY_SCANF_GZIP, 1, "gzip -dc " BENCH_PACKED);
+#endif
+#endif
+    run_sink("sink columns");
+    remove(BENCH_FILE);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    if (json) {
+        print_json(usage.ru_maxrss);
+    } else {
+        const my_scanf_stats *st = my_scanf_get_stats();
+        print_table();
+        printf("fast paths: %llu fast, %llu fallback, %llu general, %llu demotions\n",
+               st->fast, st->fallback, st->general, st->demotions);
+        printf("peak RSS %ld KiB\n", usage.ru_maxrss);
+    }
+
+    fflush(stdout);
+    if (baseline && compare_baseline(baseline, threshold) > 0) {
+        fprintf(stderr, "a case lost more than %.0f%% of its speedup or read a different count\n", threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -1,39 +1,570 @@
 // Leora Konig
 // COMP 2113 Final Project -- my_scanf
 
+#define _GNU_SOURCE             // getline()
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <math.h>
-#include <ctype.h>
+#include <fcntl.h>              // open() / mmap() for columnar files
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__PCLMUL__)
+#include <immintrin.h>
+#endif
+#ifdef MY_SCANF_THREADS
+#include <pthread.h>
+#endif
+#ifdef MY_SCANF_ZLIB
+#include <zlib.h>
+#endif
+#include "my_scanf.h"
+
+/* =========================
+   SCANNER CONTEXT
+   ========================= */
+// Position and error state of the input being scanned: stdin for my_scanf,
+// or a bounded memory view for my_sscanf and the line iterator.
+// The character helpers keep offset/line current as bytes are consumed,
+// so a failure position is known without re-reading the input.
+//
+// A stream is read with getc, but bytes looked at and not consumed are
+// kept in a small ring of the scanner's own instead of going back with
+// ungetc: look_ahead can show the next few bytes, and unget_char can put
+// back several (stdio guarantees only one ungetc). Each byte is stored
+// twice, STREAM_AHEAD apart, so the held bytes are contiguous however the
+// ring has wrapped.
+#define STREAM_AHEAD 32     // Bytes the ring holds (a power of two)
+
+typedef struct my_scanf_ctx {
+    FILE *fp;               // Stream being scanned (stream sources)
+    unsigned char ahead[2 * STREAM_AHEAD];  // Held bytes, mirrored
+    unsigned ahead_pos, ahead_len;  // Ring positions of the first held byte / past the last
+    int mem;                // Memory source: read [pos, end) instead of fp
+    const unsigned char *pos, *end;
+    long long offset;       // Bytes consumed so far
+    long long line;         // Newlines consumed so far
+    int conversion;         // Index of the conversion being processed
+    long long field_start;  // offset where that conversion's field began (after leading space)
+    long long field_end;    // offset where a width-limited field stops, 0 if unlimited
+    long long call_start;   // offset at the start of the current call (%n)
+    my_scanf_error err;     // Record of the last stop
+
+    // Recovery mode (see my_scanf_set_recovery)
+    int recover;            // Skip malformed records instead of stopping
+    FILE *reject_sink;      // Receives rejected rows, or NULL
+    long long rejected;     // Rows skipped so far
+    char *rec;              // Bytes of the current row consumed so far
+    size_t rec_len, rec_cap;
+    int rec_restart;        // A newline was consumed; next byte starts a row
+    char *skip_buf;         // getline() buffer used while resyncing
+    size_t skip_cap;
+
+    int utf8;               // UTF-8 aware %s / %D / %[ (see my_scanf_set_utf8)
+    int csv_after_sep;      // Last %qD field ended at ',', so an empty field may follow
+} scanner_state;
+
+// Scratch space for conversions that need a temporary copy of their field
+// (the %B token, the %D delimiter window). One buffer grows geometrically to
+// the largest request and is kept across calls, so a call pays neither a
+// fixed-size stack array nor an allocation.
+typedef struct {
+    char *buf;
+    size_t cap;
+} scratch_arena;
+
+// stdin has one scanner for the whole process. Everything a call works on
+// is per thread: the active scanner, its error record, the scratch arena
+// and (below) the format cache, so my_sscanf and the line iterator can run
+// on several threads at once.
+static scanner_state stdin_scanner;
+static _Thread_local scanner_state *cur = &stdin_scanner;
+static _Thread_local my_scanf_error last_error;    // Copy of the error record of the last call
+static _Thread_local scratch_arena arena;
+
+// Keeps the consumed part of the current row so a rejected row can be copied out whole.
+// Only used while a reject sink is attached.
+static void capture_char(int ch) {
+    if (ch == '\n') {              // A new row starts after this newline...
+        cur->rec_restart = 1;
+        return;
+    }
+    if (cur->rec_restart) {         // ...once its first byte is consumed
+        cur->rec_len = 0;
+        cur->rec_restart = 0;
+    }
+    if (cur->rec_len == cur->rec_cap) {
+        size_t cap = cur->rec_cap ? cur->rec_cap * 2 : 256;
+        char *grown = realloc(cur->rec, cap);
+        if (!grown) return;         // Row copy is best-effort
+        cur->rec = grown;
+        cur->rec_cap = cap;
+    }
+    cur->rec[cur->rec_len++] = (char)ch;
+}
+
+// Returns the scratch arena with room for at least n bytes, or NULL if it
+// cannot grow. The contents are kept when it grows; callers must not hold
+// the pointer across another conversion.
+static char *scratch_reserve(size_t n) {
+    if (n > arena.cap) {
+        size_t cap = arena.cap ? arena.cap : 256;
+        while (cap < n) cap *= 2;
+        char *grown = realloc(arena.buf, cap);
+        if (!grown) return NULL;
+        arena.buf = grown;
+        arena.cap = cap;
+    }
+    return arena.buf;
+}
+
+// Reads one more byte of the stream into the ring, not consuming it.
+// Returns 0 at the end of the stream.
+static int fetch_byte(void) {
+    if (!cur->fp) cur->fp = stdin;          // Scan helpers may run before my_scanf
+    int ch = getc(cur->fp);
+    if (ch == EOF) return 0;
+    unsigned i = cur->ahead_len++ % STREAM_AHEAD;
+    cur->ahead[i] = cur->ahead[i + STREAM_AHEAD] = (unsigned char)ch;
+    return 1;
+}
+
+// Reads one character from the current input and advances the counters.
+static inline int next_char(void) {
+    int ch;
+    if (cur->mem) {
+        if (cur->pos == cur->end) return EOF;
+        ch = *cur->pos++;
+    } else {
+        if (cur->field_end && cur->offset == cur->field_end) return EOF;
+        if (cur->ahead_pos != cur->ahead_len) {
+            ch = cur->ahead[cur->ahead_pos++ % STREAM_AHEAD];
+        } else {
+            if (!cur->fp) cur->fp = stdin;  // Scan helpers may run before my_scanf
+            if ((ch = getc(cur->fp)) == EOF) return EOF;
+        }
+    }
+    cur->offset++;
+    if (ch == '\n') cur->line++;
+    if (cur->reject_sink) capture_char(ch);
+    return ch;
+}
+
+// Returns a character to the current input and rewinds the counters.
+// Only the bytes just read can be returned, most recent first.
+static inline void unget_char(int ch) {
+    if (ch == EOF) return;
+    if (cur->mem) {
+        cur->pos--;
+    } else {
+        unsigned i = --cur->ahead_pos % STREAM_AHEAD;
+        cur->ahead[i] = cur->ahead[i + STREAM_AHEAD] = (unsigned char)ch;
+    }
+    cur->offset--;
+    if (ch == '\n') cur->line--;
+    if (cur->reject_sink) {
+        if (ch == '\n') cur->rec_restart = 0;      // Back inside the row
+        else if (cur->rec_len > 0) cur->rec_len--;
+    }
+}
+
+// True once the current input is exhausted.
+static int at_eof(void) {
+    return cur->mem ? cur->pos == cur->end : cur->ahead_pos == cur->ahead_len && feof(cur->fp);
+}
+
+// Bytes held in the stream ring.
+static inline int stream_held(const scanner_state *s) {
+    return (int)(s->ahead_len - s->ahead_pos);
+}
+
+// Ends a call on a stream. A single byte looked at but not consumed goes
+// back to the stream with ungetc, so the FILE is where stdio readers
+// expect it. More (after a rejected UTF-8 sequence) stay in the ring
+// for the next call.
+static void settle_stream(void) {
+    if (stream_held(cur) == 1 && ungetc(cur->ahead[cur->ahead_pos % STREAM_AHEAD], cur->fp) != EOF)
+        cur->ahead_len--;
+}
+
+// A width-limited numeric field is bounded once, when its first byte is
+// reached: a memory source narrows its end pointer to min(width, bytes
+// left) and a stream stops at an offset, so the character helpers report
+// EOF at the end of the field and the conversion loops keep no width
+// counter. limit_field returns what unlimit_field needs to restore.
+static inline const unsigned char *limit_field(int width) {
+    const unsigned char *end = cur->end;
+    if (width) {
+        cur->field_end = cur->offset + width;
+        if (cur->mem && cur->end - cur->pos > width) cur->end = cur->pos + width;
+    }
+    return end;
+}
+
+static inline void unlimit_field(const unsigned char *end) {
+    cur->end = end;
+    cur->field_end = 0;
+}
+
+// True when the EOF just seen is the end of a width-limited field rather
+// than of the input.
+static inline int at_field_end(void) {
+    return cur->field_end && cur->offset == cur->field_end;
+}
+
+// Shows up to n (a few, well under STREAM_AHEAD) unread bytes without consuming them:
+// sets *p to them and returns how many there are, fewer at the end of the
+// input or of a width-limited field. Prefixes such as "0x" or "e-" are
+// then decided with one compare, and take() consumes what matched. Callers
+// look at the second byte only once the first has matched, so a stream
+// is never read more than one byte past what a conversion consumes.
+static inline int look_ahead(int n, const unsigned char **p) {
+    if (cur->mem) {
+        *p = cur->pos;
+        return cur->end - cur->pos < n ? (int)(cur->end - cur->pos) : n;
+    }
+    if (cur->field_end && cur->field_end - cur->offset < n) n = (int)(cur->field_end - cur->offset);
+    while (stream_held(cur) < n && fetch_byte()) {}
+    *p = cur->ahead + cur->ahead_pos % STREAM_AHEAD;
+    return stream_held(cur) < n ? stream_held(cur) : n;
+}
+
+// Consumes n bytes shown by look_ahead (none of them a newline).
+static inline void take(int n) {
+    if (cur->mem) {
+        cur->pos += n;
+        cur->offset += n;
+        return;
+    }
+    while (n-- > 0) next_char();
+}
+
+// Records why the current call stopped, at the current stream position.
+static void set_error(int reason) {
+    cur->err.offset = cur->offset;
+    cur->err.line = cur->line + 1;
+    cur->err.conversion = cur->conversion;
+    cur->err.reason = reason;
+}
+
+// Records a saturated value, positioned at the start of its field,
+// unless a failure is already recorded.
+static void set_overflow(long long field_start) {
+    if (cur->err.reason != MY_SCANF_OK) return;
+    set_error(MY_SCANF_ERR_OVERFLOW);
+    cur->err.offset = field_start;
+}
+
+// Records a failed conversion, reporting EOF if that is what stopped it.
+// Always returns 0 so callers can `return fail_with(ch, reason);`.
+static int fail_with(int ch, int reason) {
+    set_error(ch == EOF && !at_field_end() ? MY_SCANF_ERR_EOF : reason);
+    return 0;
+}
+
+const my_scanf_error *my_scanf_last_error(void) {
+    return &last_error;
+}
+
+void my_scanf_reset(void) {
+    stdin_scanner.fp = NULL;            // stdin may now be a different stream
+    stdin_scanner.ahead_pos = 0;        // Bytes held from the old one are dropped
+    stdin_scanner.ahead_len = 0;
+    stdin_scanner.offset = 0;
+    stdin_scanner.line = 0;
+    stdin_scanner.conversion = 0;
+    stdin_scanner.rejected = 0;
+    stdin_scanner.rec_len = 0;
+    memset(&stdin_scanner.err, 0, sizeof(stdin_scanner.err));
+    memset(&last_error, 0, sizeof(last_error));
+}
+
+void my_scanf_set_utf8(int enabled) {
+    stdin_scanner.utf8 = enabled;
+}
+
+/* =========================
+   CHARACTER CLASSES
+   ========================= */
+// Locale-independent ASCII classification. A table lookup replaces the
+// isspace()/isdigit()/tolower() calls, whose answers depend on setlocale().
+// Indexing with (unsigned char)EOF reads entry 255, which has no class.
+enum { CC_SPACE = 1, CC_DIGIT = 2, CC_UPPER = 4, CC_LOWER = 8 };
+
+static const unsigned char char_class[256] = {
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE,
+    ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['0' ... '9'] = CC_DIGIT,
+    ['A' ... 'Z'] = CC_UPPER,
+    ['a' ... 'z'] = CC_LOWER,
+};
+
+// Digit value in bases up to 36; 99 marks "not a digit".
+static const unsigned char digit_table[256] = {
+    [0 ... 255] = 99,
+    ['0'] = 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+    ['A'] = 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22,
+            23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35,
+    ['a'] = 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22,
+            23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35,
+};
+
+#define IS_SPACE(ch)  (char_class[(unsigned char)(ch)] & CC_SPACE)
+#define IS_DIGIT(ch)  (char_class[(unsigned char)(ch)] & CC_DIGIT)
+#define TO_LOWER(ch)  ((char_class[(unsigned char)(ch)] & CC_UPPER) ? (ch) | 0x20 : (ch))
+
+/* =========================
+   SIMD HELPERS
+   ========================= */
+// Bitmask of the bytes equal to c in p[0..64): bit i is set if p[i] == c.
+// One compare + movemask per 32 bytes with AVX2, per 16 with SSE2.
+static inline uint64_t byte_mask64(const unsigned char *p, unsigned char c) {
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8((char)c);
+    uint32_t lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), needle));
+    uint32_t hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 32)), needle));
+    return (uint64_t)lo | ((uint64_t)hi << 32);
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8((char)c);
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)) << (16 * i);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i++)
+        mask |= (uint64_t)(p[i] == c) << i;
+    return mask;
+#endif
+}
+
+// Prefix XOR: bit i of the result is the parity of bits 0..i of x.
+// Applied to a quote mask it marks the bytes inside quotes.
+static inline uint64_t prefix_xor(uint64_t x) {
+#if defined(__PCLMUL__)
+    __m128i prod = _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x), _mm_set1_epi8((char)0xFF), 0);
+    return (uint64_t)_mm_cvtsi128_si64(prod);
+#else
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+#endif
+}
+
+// Length of the run of ASCII whitespace (the IS_SPACE set: ' ' and '\t'
+// through '\r') at the start of [p, end). Vector builds test 32 bytes per
+// step: a byte is whitespace if it equals ' ' or if byte - '\t' <= 4
+// unsigned, and the first byte that is neither ends the run.
+static inline size_t space_span(const unsigned char *p, const unsigned char *end) {
+    const unsigned char *start = p;
+#if defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'), four = _mm256_set1_epi8(4);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i ctl = _mm256_sub_epi8(v, tab);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                     _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, four), ctl));
+        uint32_t other = ~(uint32_t)_mm256_movemask_epi8(ws);
+        if (other) return (size_t)(p - start) + __builtin_ctz(other);
+    }
+#elif defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), four = _mm_set1_epi8(4);
+    for (; end - p >= 32; p += 32) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)p), hi = _mm_loadu_si128((const __m128i *)(p + 16));
+        __m128i ctl_lo = _mm_sub_epi8(lo, tab), ctl_hi = _mm_sub_epi8(hi, tab);
+        uint32_t ws = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(lo, space),
+                          _mm_cmpeq_epi8(_mm_min_epu8(ctl_lo, four), ctl_lo)))
+                    | (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(hi, space),
+                          _mm_cmpeq_epi8(_mm_min_epu8(ctl_hi, four), ctl_hi))) << 16;
+        if (~ws) return (size_t)(p - start) + __builtin_ctz(~ws);
+    }
+#endif
+    while (p < end && IS_SPACE(*p)) p++;
+    return (size_t)(p - start);
+}
+
+// SWAR (SIMD within a register) over 8 bytes packed in a uint64_t, with
+// p[0] in the low byte. Lane flags are 0x80 in the flagged bytes.
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGH 0x8080808080808080ULL
+
+static inline uint64_t load64(const unsigned char *p) {
+    uint64_t x;
+    memcpy(&x, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    return x;
+}
+
+// Flags the bytes that are ASCII digits.
+static inline uint64_t swar_digits(uint64_t x) {
+    uint64_t low = x & ~SWAR_HIGH;      // Keep the additions inside each byte
+    return (low + SWAR_ONES * (0x80 - '0')) & ~(low + SWAR_ONES * (0x7F - '9')) & ~x & SWAR_HIGH;
+}
+
+// Flags the bytes equal to c.
+static inline uint64_t swar_eq(uint64_t x, unsigned char c) {
+    uint64_t t = x ^ (SWAR_ONES * c);
+    return ~(((t & ~SWAR_HIGH) + ~SWAR_HIGH) | t) & SWAR_HIGH;
+}
+
+// Packs lane flags into one bit per byte (bit i for byte i).
+static inline unsigned swar_bits(uint64_t flags) {
+    return (unsigned)(((flags >> 7) * 0x0102040810204080ULL) >> 56);
+}
+
+// Given digit values d (one per byte, 0 in non-digit bytes), byte i of
+// the result is the two-digit number d[i] * 10 + d[i + 1].
+static inline uint64_t swar_pairs(uint64_t d) {
+    return d * 10 + (d >> 8);
+}
+
+// Value of the n (1..8) digits at the start of the word x (first digit in
+// the low byte): three multiply-and-shift steps merge digit pairs, then
+// pairs of pairs, then the two halves.
+static inline uint64_t swar_number(uint64_t x, int n) {
+    x <<= 8 * (8 - n);                  // Drop the bytes after the digits; leading zeros are harmless
+    x = (x & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    x = (x & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (x & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+}
+
+// Number of leading digits in the word x (0..8).
+static inline int swar_digit_run(uint64_t x) {
+    uint64_t others = ~swar_digits(x) & SWAR_HIGH;
+    return others ? __builtin_ctzll(others) >> 3 : 8;
+}
+
+static const uint64_t pow10_u64[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+// Consumes n bytes of a memory source in one step, keeping the counters exact.
+static void skip_view(size_t n) {
+    const unsigned char *p = cur->pos, *stop = cur->pos + n;
+    while ((p = memchr(p, '\n', stop - p)) != NULL) {
+        cur->line++;
+        p++;
+    }
+    cur->offset += n;
+    cur->pos = stop;
+}
+
+/* =========================
+   UTF-8 HELPERS
+   ========================= */
+// Reads the rest of a UTF-8 sequence whose lead byte was already consumed.
+// The raw bytes go to seq[0..*len). Returns the code point, or -1 for an
+// invalid sequence (overlong forms, surrogates and values past U+10FFFF
+// are rejected; the offending byte is left in the stream).
+static int utf8_read(int lead, unsigned char *seq, int *len) {
+    int need, cp, lo = 0x80, hi = 0xBF;
+    seq[0] = (unsigned char)lead;
+    *len = 1;
+
+    if (lead < 0x80) return lead;
+    if (lead >= 0xC2 && lead <= 0xDF)      { need = 1; cp = lead & 0x1F; }
+    else if (lead >= 0xE0 && lead <= 0xEF) { need = 2; cp = lead & 0x0F;
+                                             if (lead == 0xE0) lo = 0xA0;
+                                             if (lead == 0xED) hi = 0x9F; }
+    else if (lead >= 0xF0 && lead <= 0xF4) { need = 3; cp = lead & 0x07;
+                                             if (lead == 0xF0) lo = 0x90;
+                                             if (lead == 0xF4) hi = 0x8F; }
+    else return -1;
+
+    while (need-- > 0) {
+        int ch = next_char();
+        if (ch < lo || ch > hi) {
+            unget_char(ch);
+            return -1;
+        }
+        seq[(*len)++] = (unsigned char)ch;
+        cp = (cp << 6) | (ch & 0x3F);
+        lo = 0x80;
+        hi = 0xBF;
+    }
+    return cp;
+}
+
+// Decodes one UTF-8 code point from a NUL-terminated string (the format),
+// advancing *s past it. Invalid bytes decode as themselves.
+static int utf8_decode_str(const char **s) {
+    const unsigned char *p = (const unsigned char *)*s;
+    int cp = p[0], need = 0;
+    if (cp >= 0xC2 && cp <= 0xDF)      { need = 1; cp &= 0x1F; }
+    else if (cp >= 0xE0 && cp <= 0xEF) { need = 2; cp &= 0x0F; }
+    else if (cp >= 0xF0 && cp <= 0xF4) { need = 3; cp &= 0x07; }
+    for (int i = 1; i <= need; i++) {
+        if ((p[i] & 0xC0) != 0x80) { *s += 1; return p[0]; }
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+    *s += need + 1;
+    return cp;
+}
+
+// Pushes a consumed byte sequence back, last byte first.
+static void unget_bytes(const unsigned char *seq, int len) {
+    while (len > 0) unget_char(seq[--len]);
+}
+
+// Unicode White_Space code points outside ASCII.
+static int is_unicode_space(int cp) {
+    return cp == 0x85 || cp == 0xA0 || cp == 0x1680 ||
+           (cp >= 0x2000 && cp <= 0x200A) ||
+           cp == 0x2028 || cp == 0x2029 || cp == 0x202F ||
+           cp == 0x205F || cp == 0x3000;
+}
 
 /* =========================
    BASIC HELPERS
    ========================= */
 // Reads and discards leading whitespace characters from stdin.
 // Stops at first non-whitespace character or EOF.
+// In UTF-8 mode Unicode whitespace (U+00A0, U+3000, ...) is skipped too.
 void skip_whitespace(void) {
     int ch;
-    while ((ch = getchar()) != EOF && isspace(ch)) { }
-    if (ch != EOF) ungetc(ch, stdin);                   // discard
+    if (cur->mem) skip_view(space_span(cur->pos, cur->end));   // ASCII run in one step
+    for (;;) {
+        while ((ch = next_char()) != EOF && IS_SPACE(ch)) { }
+        // Only these lead bytes can start a non-ASCII space character
+        if (!cur->utf8 || (ch != 0xC2 && ch != 0xE1 && ch != 0xE2 && ch != 0xE3)) break;
+        unsigned char seq[4];
+        int len;
+        int cp = utf8_read(ch, seq, &len);
+        if (cp < 0 || !is_unicode_space(cp)) {
+            unget_bytes(seq, len);
+            ch = EOF;                                // Already put back
+            break;
+        }
+    }
+    if (ch != EOF) unget_char(ch);                   // discard
+    cur->field_start = cur->offset;
 }
 
 // Returns next character in stdin without consuming it.
 // Returns EOF if no input remains.
 int peek_char(void) {
-    int ch = getchar();
-    if (ch != EOF) ungetc(ch, stdin);
-    return ch;
+    const unsigned char *p;
+    return look_ahead(1, &p) ? *p : EOF;
 }
 
 // Attempt to match a single literal character from input.
 // Returns 1 if next character matches expected literal, else 0.
 // Non-matching characters are returned to stdin.
 int match_literal(char expected) {
-    int ch = getchar();
+    int ch = next_char();
     if (ch != expected) {                  // If the character doesn't match the literal
-        if (ch != EOF) ungetc(ch, stdin);
+        if (ch != EOF) unget_char(ch);
         return 0;
     }
     return 1;
@@ -42,7 +573,7 @@ int match_literal(char expected) {
 // Compares two strings ignoring case. Returns 1 if identical, 0 if not.
 int str_eq_ignore_case(const char *a, const char *b) {
     while (*a && *b) {
-        if (tolower(*a) != tolower(*b)) return 0;  // Convert to lowercase to ignore case
+        if (TO_LOWER(*a) != TO_LOWER(*b)) return 0;  // Convert to lowercase to ignore case
         a++; b++;
     }
     return *a == '\0' && *b == '\0';
@@ -63,6 +594,10 @@ void store_signed_integer(void *ptr, const char *length, long long value) {
             *(long*)ptr = (long)value;                // %ld
         else if (strcmp(length, "ll") == 0)
             *(long long*)ptr = value;                 // %lld
+        else if (strcmp(length, "j") == 0)
+            *(intmax_t*)ptr = value;                  // %jd
+        else if (strcmp(length, "z") == 0 || strcmp(length, "t") == 0)
+            *(ptrdiff_t*)ptr = (ptrdiff_t)value;      // %zd / %td
         else
             *(int*)ptr = (int)value;                  // Default integer
     } else {
@@ -71,317 +606,493 @@ void store_signed_integer(void *ptr, const char *length, long long value) {
     }
 }
 
-// Apply a parsed sign and store the resulting integer value.
-int store_integer_with_sign(void *ptr, const char *length, long long val, int sign) {
-    val *= sign;   // Apply '+' or '-' determined during parsing
-    store_signed_integer(ptr, length, val);
-    return 1;      // Assignment succeeded
+// Store an unsigned integer value into the destination pointer, honoring length modifier.
+void store_unsigned_integer(void *ptr, const char *length, unsigned long long value) {
+    if (length && strcmp(length, "hh") == 0)
+        *(unsigned char*)ptr = (unsigned char)value;        // %hhx
+    else if (length && strcmp(length, "h") == 0)
+        *(unsigned short*)ptr = (unsigned short)value;      // %hx
+    else if (length && strcmp(length, "l") == 0)
+        *(unsigned long*)ptr = (unsigned long)value;        // %lx
+    else if (length && strcmp(length, "ll") == 0)
+        *(unsigned long long*)ptr = value;                  // %llx
+    else if (length && strcmp(length, "j") == 0)
+        *(uintmax_t*)ptr = value;                           // %ju
+    else if (length && (strcmp(length, "z") == 0 || strcmp(length, "t") == 0))
+        *(size_t*)ptr = (size_t)value;                      // %zu / %tu
+    else
+        *(unsigned int*)ptr = (unsigned int)value;          // Default unsigned
+}
+
+// Range of the destination type selected by the length modifier.
+// Saturating to these limits keeps an out-of-range value from being truncated.
+static void integer_limits(const char *length, int is_unsigned,
+                           long long *min, unsigned long long *max) {
+    if (length && strcmp(length, "hh") == 0) {
+        *min = SCHAR_MIN; *max = is_unsigned ? UCHAR_MAX : SCHAR_MAX;
+    } else if (length && strcmp(length, "h") == 0) {
+        *min = SHRT_MIN;  *max = is_unsigned ? USHRT_MAX : SHRT_MAX;
+    } else if (length && strcmp(length, "l") == 0) {
+        *min = LONG_MIN;  *max = is_unsigned ? ULONG_MAX : LONG_MAX;
+    } else if (length && strcmp(length, "ll") == 0) {
+        *min = LLONG_MIN; *max = is_unsigned ? ULLONG_MAX : LLONG_MAX;
+    } else if (length && strcmp(length, "j") == 0) {
+        *min = INTMAX_MIN; *max = is_unsigned ? UINTMAX_MAX : INTMAX_MAX;
+    } else if (length && (strcmp(length, "z") == 0 || strcmp(length, "t") == 0)) {
+        *min = PTRDIFF_MIN; *max = is_unsigned ? SIZE_MAX : PTRDIFF_MAX;
+    } else {
+        *min = INT_MIN;   *max = is_unsigned ? UINT_MAX : INT_MAX;
+    }
 }
 
 /* =========================
    DIGIT & SIGN HELPERS
    ========================= */
-// Reads up to `width` digits from stdin in a given numeric base.
-// Stores result in *value, returns 1 if at least 1 digit read.
-int scan_digits_width(long long *value, int base, long long width) {
-    int ch, count = 0;
-    long long val = 0;
+// Numeric value of a digit character in bases up to 36, or 99 if not a digit.
+static inline int digit_value(int ch) {
+    return digit_table[(unsigned char)ch];
+}
+
+// Decimal floats are read as an integer mantissa of up to 19 significant
+// digits and a power-of-ten exponent. Digits past the 19th only scale the
+// integer part (or are dropped from the fraction).
+static inline void add_decimal_digit(uint64_t *mantissa, int *significant, int *exp10, int digit, int fraction) {
+    if (*significant < 19) {
+        *mantissa = *mantissa * 10 + (uint64_t)digit;
+        *significant += (*mantissa != 0);
+        *exp10 -= fraction;
+    } else if (!fraction) {
+        (*exp10)++;
+    }
+}
+
+// mantissa * 10^exp10. When the mantissa fits in 53 bits and |exp10| <= 22
+// this is one exact multiply or divide, so the result is correctly rounded;
+// otherwise the value is scaled with pow().
+static double decimal_to_double(uint64_t mantissa, int exp10) {
+    static const double exact_pow10[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    if (mantissa <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+        return exp10 >= 0 ? (double)mantissa * exact_pow10[exp10] : (double)mantissa / exact_pow10[-exp10];
+    return (double)mantissa * pow(10.0, exp10);
+}
 
-    // Consume characters while width allows and input is valid for the base
-    while ((width == 0 || count < width) && (ch = getchar()) != EOF) {
-        int digit = -1;
+// Reads digits in a given numeric base up to the end of the field (see
+// limit_field), accumulating into *value. On overflow the value saturates
+// at ULLONG_MAX and *overflow is set. Returns the number of digits read.
+static int scan_digits(unsigned long long *value, int base, int *overflow) {
+    int ch, count = 0;
+    unsigned long long val = *value;
+
+    // Memory sources: one pass over the bounded slice, consumed at once
+    if (cur->mem) {
+        const unsigned char *p = cur->pos, *end = cur->end;
+        for (int digit; p < end && (digit = digit_value(*p)) < base; p++) {
+            if (__builtin_mul_overflow(val, (unsigned)base, &val) |
+                __builtin_add_overflow(val, (unsigned)digit, &val)) {
+                val = ULLONG_MAX;
+                *overflow = 1;
+            }
+        }
+        count = (int)(p - cur->pos);
+        skip_view(count);
+        *value = val;
+        return count;
+    }
 
-        // Convert character to numeric digit value
-        if (isdigit(ch))
-            digit = ch - '0';
-        else if (isalpha(ch))
-            digit = tolower(ch) - 'a' + 10;
+    // Consume characters while input is valid for the base
+    while ((ch = next_char()) != EOF) {
+        int digit = digit_value(ch);
 
         // Stop at first invalid digit and return it to the stream
-        if (digit < 0 || digit >= base) {
-            ungetc(ch, stdin);
+        if (digit >= base) {
+            unget_char(ch);
             break;
         }
 
-        // Detect overflow before multiplication/addition
-        // Clamp to LLONG_MAX to mimic scanf-style saturation behavior
-        if (val > (LLONG_MAX - digit) / base)
-            val = LLONG_MAX;
-        else
-            val = val * base + digit;
+        // Overflow builtins compile to a carry-flag test, so the
+        // non-overflowing path costs the same as a plain multiply-add
+        if (__builtin_mul_overflow(val, (unsigned)base, &val) |
+            __builtin_add_overflow(val, (unsigned)digit, &val)) {
+            val = ULLONG_MAX;
+            *overflow = 1;
+        }
 
         count++;
     }
 
-    // No digits read → conversion failed
-    if (count == 0) return 0;
     *value = val;
-    return 1;
+    return count;
 }
 
-// Applies optional scientific notation ('e' or 'E') to an already-parsed float.
+// Applies optional scientific notation ('e' or 'E') to a decimal exponent.
 // Returns 0 only if an exponent marker is present but malformed.
-static int apply_exponent(double *result) {
-    int ch = peek_char();
+static int apply_exponent(int *exp10) {
+    const unsigned char *p;
+    int ch;
 
     // No exponent → nothing to apply
-    if (ch != 'e' && ch != 'E') return 1;
-
-    getchar();    // Consume 'e' or 'E'
+    if (!look_ahead(1, &p) || (p[0] | 0x20) != 'e') return 1;
 
-    // Optional exponent sign
-    int exp_sign = 1;
-    ch = peek_char();
-    if (ch == '+') getchar();
-    else if (ch == '-') { getchar(); exp_sign = -1; }
+    // 'e' / 'E' and an optional sign
+    int exp_sign = 1, n = look_ahead(2, &p);
+    if (n == 2 && (p[1] == '+' || p[1] == '-')) {
+        if (p[1] == '-') exp_sign = -1;
+        take(2);
+    } else {
+        take(1);
+    }
 
     int digits = 0;
     int exponent = 0;
 
-    // Parse exponent digits
-    while (isdigit(ch = getchar())) {
-        exponent = exponent*10 + (ch-'0');
+    // Parse exponent digits (large exponents saturate; pow() gives 0 or inf anyway)
+    while (IS_DIGIT(ch = next_char())) {
+        if (exponent < 100000) exponent = exponent*10 + (ch-'0');
         digits++;
     }
 
     // Put back first non-digit character
-    if (ch != EOF) ungetc(ch, stdin);
+    if (ch != EOF) unget_char(ch);
 
     // 'e' present but no digits → invalid exponent
-    if (digits == 0) return 0;
+    if (digits == 0) return fail_with(ch, MY_SCANF_ERR_EXPONENT);
+
+    *exp10 += exp_sign * exponent;
+    return 1;
+}
+
+// Parses a hexadecimal float after its "0x" prefix (%a).
+// Mantissa digits go through the same digit decoder as the integer engine;
+// an optional 'p' / 'P' introduces a binary exponent.
+// Returns 0 if no mantissa digits or a malformed exponent is found.
+static int scan_hex_float(double *result) {
+    unsigned long long mantissa = 0;
+    int exponent = 0, digits = 0, ch;
+
+    // Integer and fractional hex digits; digits beyond 60 bits of precision only move the exponent
+    int seen_dot = 0;
+    for (;;) {
+        ch = next_char();
+        if (ch == '.' && !seen_dot) { seen_dot = 1; continue; }
+        int d = digit_value(ch);
+        if (d >= 16) break;
+        if (mantissa >> 60) { if (!seen_dot) exponent += 4; }
+        else { mantissa = mantissa * 16 + d; if (seen_dot) exponent -= 4; }
+        digits++;
+    }
+    if (ch != EOF) unget_char(ch);
+    if (digits == 0) return fail_with(ch, MY_SCANF_ERR_NO_DIGITS);
+
+    // Optional binary exponent
+    const unsigned char *p;
+    if (look_ahead(1, &p) && (p[0] | 0x20) == 'p') {
+        int exp_sign = 1, exp_digits = 0, e = 0, n = look_ahead(2, &p);
+        int has_sign = n == 2 && (p[1] == '+' || p[1] == '-');
+        if (has_sign && p[1] == '-') exp_sign = -1;
+        take(1 + has_sign);
+        while ((ch = next_char()) >= '0' && ch <= '9') {
+            if (e < 100000) e = e * 10 + (ch - '0');
+            exp_digits++;
+        }
+        if (ch != EOF) unget_char(ch);
+        if (exp_digits == 0) return fail_with(ch, MY_SCANF_ERR_EXPONENT);
+        exponent += exp_sign * e;
+    }
 
-    // Apply exponent as power of 10
-    *result *= pow(10.0, exp_sign*exponent);
+    *result = ldexp((double)mantissa, exponent);
     return 1;
 }
 
 /* =========================
    SCAN FUNCTIONS
    ========================= */
-
-// Parses a signed decimal integer (%d).
+// Membership of a %[...] conversion.
+#define SCANSET_MAX_CODEPOINTS 32
+typedef struct {
+    unsigned char bytes[32];                    // Bitmap of member bytes
+    int codepoints[SCANSET_MAX_CODEPOINTS];     // Non-ASCII members (UTF-8 mode)
+    int cp_count;
+    int negated;                                // "[^...]"
+} scanset;
+
+// Shared integer engine for %d / %u (base 10), %x / %p (base 16), %o (base 8)
+// and %b (base 2). Base 0 auto-detects the base from a 0x / 0 prefix (%i).
 // Returns 1 on successful conversion.
-// Handles optional sign, width limiting, overflow saturation,
-// and stores according to the length modifier.
-int scan_int(void *ptr, int width, const char *length) {
+// Handles optional sign and base prefix (both count toward width), and saturates
+// to the limits of the destination type chosen by the length modifier.
+int scan_integer(void *ptr, int width, const char *length, int base, int is_unsigned) {
     skip_whitespace();  // scanf skips leading whitespace for numeric conversions
 
-    int sign = 1;
-    int ch = peek_char();
+    long long start = cur->offset;
+    const unsigned char *end = limit_field(width);
+    int negative = 0, digits = 0, overflow = 0;
+    unsigned long long magnitude = 0;
+    const unsigned char *p;
+    int n = look_ahead(1, &p);
 
     // Optional sign handling
-    if (ch == '+' || ch == '-') {
-        getchar();                      // consume sign
-        sign = (ch == '-') ? -1 : 1;
-        if (width > 0) width--;         // sign counts toward width
+    if (n && (p[0] == '+' || p[0] == '-')) {
+        negative = (p[0] == '-');
+        take(1);                        // consume sign
     }
 
-    long long value = 0;
-    int digits_read = 0;
-
-    // Read digits while respecting width
-    while ((width == 0 || digits_read < width) &&
-           (ch = getchar()) != EOF && isdigit(ch)) {
-
-        int digit = ch - '0';
-
-        // Detect and saturate on overflow
-        if (value > (LLONG_MAX - digit) / 10)
-            value = LLONG_MAX;
-        else
-            value = value * 10 + digit;
-
-        digits_read++;
+    // Optional base prefix: 0x / 0X for hex, 0b / 0B for binary, compared
+    // as two bytes; a '0' without the marker is left for the digit loop
+    if ((base == 0 || base == 16 || base == 2) && look_ahead(1, &p) && p[0] == '0') {
+        int marker = (base == 2) ? 'b' : 'x';
+        if (look_ahead(2, &p) == 2 && (p[1] | 0x20) == marker) {
+            take(2);
+            if (base == 0) base = 16;
+            // libc takes the '0' of a bare "0x" as the value; %b rejects a bare "0b"
+            digits = (base == 16);
+        } else if (base == 0) {
+            base = 8;
+        }
     }
+    if (base == 0) base = 10;
+
+    digits += scan_digits(&magnitude, base, &overflow);
 
     // No digits read → conversion failure
-    if (digits_read == 0) {
-        if (ch != EOF) ungetc(ch, stdin);
+    if (digits == 0) {
+        fail_with(peek_char(), MY_SCANF_ERR_NO_DIGITS);
+        unlimit_field(end);
         return 0;
     }
+    unlimit_field(end);
 
-    // Put back the first non-digit character
-    if (ch != EOF && !isdigit(ch))
-        ungetc(ch, stdin);
-
-    // Apply sign and store into destination
-    return store_integer_with_sign(ptr, length, value, sign);
-}
-
-// Parses a hexadecimal integer (%x / %X).
-// Returns 1 on successful conversion.
-// Accepts optional 0x / 0X prefix and respects width.
-int scan_hex(void *ptr, int width, const char *length) {
-    skip_whitespace();
-
-    int digits = 0;
-    long long val = 0;
-    int ch = getchar();
+    long long min;
+    unsigned long long max;
+    integer_limits(length, is_unsigned, &min, &max);
 
-    // Optional leading 0x / 0X prefix
-    if (ch == '0') {
-        digits = 1;                     // count leading zero
-        val = 0;
-        int next = getchar();
-        if (next == 'x' || next == 'X') {
-            // prefix fully consumed
+    if (is_unsigned) {
+        // Negative input wraps like strtoul; out-of-range input saturates
+        if (magnitude > max) { magnitude = max; overflow = 1; }
+        else if (negative) magnitude = (max - magnitude + 1) & max;
+        store_unsigned_integer(ptr, length, magnitude);
+    } else {
+        long long value;
+        if (negative && magnitude > (unsigned long long)-(min + 1) + 1) {
+            value = min;
+            overflow = 1;
+        } else if (negative) {
+            value = magnitude ? -(long long)(magnitude - 1) - 1 : 0;
+        } else if (magnitude > max) {
+            value = (long long)max;
+            overflow = 1;
         } else {
-            ungetc(next, stdin);        // not actually a prefix
+            value = (long long)magnitude;
         }
-    } else {
-        ungetc(ch, stdin);
+        store_signed_integer(ptr, length, value);
     }
 
-    // Consume hexadecimal digits
-    while ((ch = getchar()) != EOF) {
-        int d;
-
-        if ('0' <= ch && ch <= '9') d = ch - '0';
-        else if ('a' <= ch && ch <= 'f') d = ch - 'a' + 10;
-        else if ('A' <= ch && ch <= 'F') d = ch - 'A' + 10;
-        else {
-            ungetc(ch, stdin);          // non-hex character
-            break;
-        }
+    if (overflow) set_overflow(start);
+    return 1;
+}
 
-        val = val * 16 + d;
-        digits++;
+// Body of scan_float, run inside the field's width limit.
+static int scan_float_field(double *ptr) {
+    int ch, sign = 1;
+    const unsigned char *p;
+    int n = look_ahead(1, &p);
 
-        if (width && digits >= width) break;
+    // Optional sign
+    if (n && (p[0] == '+' || p[0] == '-')) {
+        if (p[0] == '-') sign = -1;
+        take(1);
     }
 
-    if (digits == 0) return 0;
-
-    store_signed_integer(ptr, length, val);
-    return 1;
-}
-
-// Parses a binary integer (%b extension).
-// RETURN VALUE:
-//   1 if at least one binary digit was parsed
-//   0 if input was not binary
-//  -1 if EOF encountered before input
-// Accepts optional 0b / 0B prefix.
-int scan_binary(int *value) {
-    int ch;
-    int result = 0;
-    int found_digit = 0;
+    uint64_t mantissa = 0;
+    int significant = 0, exp10 = 0, digits_read = 0;
 
-    // Skip leading whitespace
-    while ((ch = getchar()) != EOF &&
-           (ch == ' ' || ch == '\t' || ch == '\n')) { }
+    // Hexadecimal float: a leading "0x" switches to the binary-exponent form
+    if (look_ahead(1, &p) && p[0] == '0' && look_ahead(2, &p) == 2 && (p[1] | 0x20) == 'x') {
+        take(2);
+        double result = 0.0;
+        if (!scan_hex_float(&result)) return 0;
+        *ptr = result * sign;
+        return 1;
+    }
 
-    if (ch == EOF) {
-        *value = 0;
-        return -1;
+    // Integer portion
+    while (IS_DIGIT(ch = next_char())) {
+        add_decimal_digit(&mantissa, &significant, &exp10, ch - '0', 0);
+        digits_read++;
     }
 
-    // Optional 0b / 0B prefix
-    if (ch == '0') {
-        int next = getchar();
-        if (next == 'b' || next == 'B')
-            ch = getchar();
-        else {
-            ungetc(next, stdin);
-            ch = '0';
+    // Fractional portion
+    if (ch == '.') {
+        while (IS_DIGIT(ch = next_char())) {
+            add_decimal_digit(&mantissa, &significant, &exp10, ch - '0', 1);
+            digits_read++;
         }
     }
+    unget_char(ch);
 
-    // Consume binary digits
-    while (ch == '0' || ch == '1') {
-        found_digit = 1;
-        result = (result << 1) | (ch - '0');
-        ch = getchar();
-    }
+    if (digits_read == 0) return fail_with(peek_char(), MY_SCANF_ERR_NO_DIGITS);
 
-    if (ch != EOF) ungetc(ch, stdin);
+    // Optional exponent (e / E)
+    if (!apply_exponent(&exp10)) return 0;
 
-    *value = result;
-    return found_digit ? 1 : 0;
+    *ptr = decimal_to_double(mantissa, exp10) * sign;
+    return 1;
 }
 
-// Parses a floating-point value (%f).
+// Parses a floating-point value (%f, %e, %g, %a).
 // Returns 1 on successful conversion.
-// Supports optional sign, fractional part, and scientific notation.
+// Supports optional sign, fractional part, scientific notation
+// and hexadecimal floats (0x1.8p3). The sign, prefix, digits and
+// exponent all count toward width.
 int scan_float(double *ptr, int width) {
     skip_whitespace();
 
-    int ch = peek_char();
-    if (ch == EOF) return 0;
+    if (peek_char() == EOF) return fail_with(EOF, MY_SCANF_ERR_EOF);
 
-    int sign = 1;
+    const unsigned char *end = limit_field(width);
+    int r = scan_float_field(ptr);
+    unlimit_field(end);
+    return r;
+}
 
-    // Optional sign
-    if (ch == '+' || ch == '-') {
-        if (getchar() == '-') sign = -1;
-        if (width) width--;
-    }
+// Appends one byte of a %L field to its copy in the scratch arena.
+// Returns 0 if the arena cannot grow.
+static int keep_byte(size_t *len, int ch) {
+    char *buf = scratch_reserve(*len + 2);
+    if (!buf) return 0;
+    buf[(*len)++] = (char)ch;
+    return 1;
+}
 
-    double result = 0.0;
-    int digits_read = 0;
+// Consumes and keeps a run of decimal (or hex) digits. Returns the count,
+// or -1 if the arena cannot grow.
+static int keep_digits(size_t *len, int hex) {
+    int ch, count = 0;
+    while ((ch = next_char()) != EOF && digit_value(ch) < (hex ? 16 : 10)) {
+        if (!keep_byte(len, ch)) return -1;
+        count++;
+    }
+    unget_char(ch);
+    return count;
+}
 
-    // Integer portion
-    while (isdigit(ch = peek_char()) &&
-           (width == 0 || width-- > 0)) {
-        getchar();
-        result = result * 10 + (ch - '0');
-        digits_read++;
+// Body of scan_long_double, run inside the field's width limit. Accepts
+// the same syntax as scan_float_field, but keeps the field's text and
+// converts it with strtold: mantissa * 10^exp10 is only exact to double
+// precision, and %L must round like libc does.
+static int scan_long_double_field(long double *ptr) {
+    size_t len = 0;
+    const unsigned char *p;
+    int n = look_ahead(1, &p), hex = 0;
+
+    if (n && (p[0] == '+' || p[0] == '-')) {
+        if (!keep_byte(&len, p[0])) return 0;
+        take(1);
+    }
+    if (look_ahead(1, &p) && p[0] == '0' && look_ahead(2, &p) == 2 && (p[1] | 0x20) == 'x') {
+        if (!keep_byte(&len, '0') || !keep_byte(&len, 'x')) return 0;
+        take(2);
+        hex = 1;
     }
 
-    // Fractional portion
-    if (peek_char() == '.' && (width == 0 || width > 0)) {
-        getchar();                      // consume '.'
-        double divisor = 10.0;
-
-        while (isdigit(ch = peek_char()) &&
-               (width == 0 || width-- > 0)) {
-            getchar();
-            result += (ch - '0') / divisor;
-            divisor *= 10.0;
-            digits_read++;
-        }
+    int digits = keep_digits(&len, hex);
+    if (digits >= 0 && look_ahead(1, &p) && p[0] == '.') {
+        if (!keep_byte(&len, '.')) return 0;
+        take(1);
+        int fraction = keep_digits(&len, hex);
+        digits = fraction < 0 ? -1 : digits + fraction;
+    }
+    if (digits < 0) return 0;
+    if (digits == 0) return fail_with(peek_char(), MY_SCANF_ERR_NO_DIGITS);
+
+    // Exponent: 'e' for decimal, 'p' (binary) for hex
+    if (look_ahead(1, &p) && (p[0] | 0x20) == (hex ? 'p' : 'e')) {
+        int has_sign = look_ahead(2, &p) == 2 && (p[1] == '+' || p[1] == '-');
+        if (!keep_byte(&len, p[0]) || (has_sign && !keep_byte(&len, p[1]))) return 0;
+        take(1 + has_sign);
+        int exp_digits = keep_digits(&len, 0);
+        if (exp_digits < 0) return 0;
+        if (exp_digits == 0) return fail_with(peek_char(), MY_SCANF_ERR_EXPONENT);
     }
 
-    if (digits_read == 0) return 0;
+    arena.buf[len] = '\0';
+    *ptr = strtold(arena.buf, NULL);
+    return 1;
+}
 
-    // Optional exponent (e / E)
-    if (!apply_exponent(&result)) return 0;
+// Parses a floating-point value for %Lf / %Le / %Lg / %La, in long double
+// precision. Otherwise behaves like scan_float.
+int scan_long_double(long double *ptr, int width) {
+    skip_whitespace();
 
-    *ptr = result * sign;
-    return 1;
+    if (peek_char() == EOF) return fail_with(EOF, MY_SCANF_ERR_EOF);
+
+    const unsigned char *end = limit_field(width);
+    int r = scan_long_double_field(ptr);
+    unlimit_field(end);
+    return r;
 }
 
 // Reads one or more raw characters (%c).
 // Returns 1 on successful conversion.
 // Does not skip whitespace unless width > 1.
+// A NULL c discards the characters (%*c).
 int scan_char(char *c, int width) {
     int ch, count = 0;
 
     while (count < (width ? width : 1) &&
-           (ch = getchar()) != EOF)
-        c[count++] = (char)ch;
+           (ch = next_char()) != EOF) {
+        if (c) c[count] = (char)ch;
+        count++;
+    }
 
-    return count ? 1 : 0;
+    if (count == 0) return fail_with(EOF, MY_SCANF_ERR_EOF);
+    return 1;
 }
 
 // Reads a whitespace-delimited string (%s).
 // Returns 1 on successful conversion.
 // Skips leading whitespace and stops at first space.
+// In UTF-8 mode the input must be valid UTF-8, Unicode spaces end the
+// string and a code point is never split by the width limit.
+// A NULL buf discards the string (%*s), so no width limit applies.
 int scan_string(char *buf, int max_width) {
-    int ch, count = 0;
+    int ch = 0, count = 0;
 
     skip_whitespace();
 
-    while ((ch = getchar()) != EOF &&
-           !isspace(ch) &&
-           count < max_width)
-        buf[count++] = (char)ch;
-
-    if (ch != EOF && isspace(ch))
-        ungetc(ch, stdin);
+    while (count < max_width && (ch = next_char()) != EOF) {
+        if (IS_SPACE(ch)) {
+            unget_char(ch);
+            break;
+        }
+        if (cur->utf8 && ch >= 0x80) {
+            unsigned char seq[4];
+            int len;
+            int cp = utf8_read(ch, seq, &len);
+            if (cp < 0) {
+                unget_bytes(seq, len);
+                if (buf) buf[count] = '\0';
+                set_error(MY_SCANF_ERR_ENCODING);
+                return 0;
+            }
+            if (is_unicode_space(cp) || count + len > max_width) {
+                unget_bytes(seq, len);
+                break;
+            }
+            if (buf) memcpy(buf + count, seq, len);
+            count += len;
+            continue;
+        }
+        if (buf) buf[count] = (char)ch;
+        count++;
+    }
 
-    buf[count] = '\0';
-    return count > 0;
+    if (buf) buf[count] = '\0';
+    if (count == 0) return fail_with(ch, MY_SCANF_ERR_INVALID);
+    return 1;
 }
 
 // Reads characters until a delimiter sequence is matched (%D).
@@ -391,87 +1102,392 @@ int scan_string(char *buf, int max_width) {
 //  -1 on EOF with no input
 // Supports multi-character delimiters
 // using sliding-window matching.
+// In UTF-8 mode whole code points are read (invalid input fails), and
+// Unicode spaces end the field like ' ' does for single-character delimiters.
+// A NULL buf discards the field (%*D).
 int scan_delimited_string(char *buf, int max_width, const char *delimiter) {
-    int ch, count = 0;
+    int ch = 0, count = 0;
     size_t delim_len = strlen(delimiter);
-    char window[128];
+    char *window = scratch_reserve(delim_len + 1);
     size_t win_count = 0;
 
-    if (delim_len >= sizeof(window)) return 0;
+    if (!window) return 0;
 
-    while ((ch = getchar()) != EOF && count < max_width) {
+    while (count < max_width && (ch = next_char()) != EOF) {
         // Empty line → no conversion
         if (count == 0 && ch == '\n') {
-            buf[0] = '\0';
-            ungetc(ch, stdin);
-            return 0;
+            if (buf) buf[0] = '\0';
+            unget_char(ch);
+            return fail_with(ch, MY_SCANF_ERR_INVALID);
         }
 
-        buf[count++] = (char)ch;
-
-        // Sliding window for delimiter detection
-        if (delim_len > 0) {
-            if (win_count < delim_len)
-                window[(int)(win_count++)] = (char)ch;
-            else {
-                memmove(window, window + 1, delim_len - 1);
-                window[(int)(delim_len - 1)] = (char)ch;
+        // Bytes of this character: one, or a whole UTF-8 sequence
+        unsigned char seq[4];
+        int len = 1;
+        seq[0] = (unsigned char)ch;
+        if (cur->utf8 && ch >= 0x80) {
+            int cp = utf8_read(ch, seq, &len);
+            if (cp < 0) {
+                unget_bytes(seq, len);
+                if (buf) buf[count] = '\0';
+                set_error(MY_SCANF_ERR_ENCODING);
+                return 0;
             }
-
-            // Full delimiter matched → stop
-            if (win_count == delim_len &&
-                strncmp(window, delimiter, delim_len) == 0) {
-                count -= (int)delim_len;
+            if ((delim_len == 1 && is_unicode_space(cp)) || count + len > max_width) {
+                unget_bytes(seq, len);
                 break;
             }
         }
 
+        int matched = 0;
+        for (int i = 0; i < len && !matched; i++) {
+            if (buf) buf[count] = (char)seq[i];
+            count++;
+
+            // Sliding window for delimiter detection
+            if (delim_len > 0) {
+                if (win_count < delim_len)
+                    window[(int)(win_count++)] = (char)seq[i];
+                else {
+                    memmove(window, window + 1, delim_len - 1);
+                    window[(int)(delim_len - 1)] = (char)seq[i];
+                }
+
+                // Full delimiter matched → stop
+                if (win_count == delim_len &&
+                    strncmp(window, delimiter, delim_len) == 0) {
+                    count -= (int)delim_len;
+                    matched = 1;
+                }
+            }
+        }
+        if (matched) break;
+
         // Single-character whitespace delimiter handling
         if (delim_len == 1 &&
             delimiter[0] != ch &&
             (ch == ' ' || ch == '\t' || ch == '\n')) {
             count--;
-            ungetc(ch, stdin);
+            unget_char(ch);
             break;
         }
     }
 
     if (ch == EOF && count == 0) {
-        buf[0] = '\0';
+        if (buf) buf[0] = '\0';
+        set_error(MY_SCANF_ERR_EOF);
         return -1;
     }
 
-    buf[count] = '\0';
+    if (buf) {
+        buf[count] = '\0';
 
-    // Trim trailing newline
-    if (count > 0 && buf[count - 1] == '\n') {
-        buf[count - 1] = '\0';
-        count--;
+        // Trim trailing newline (never the only byte: a leading '\n' ends the
+        // field above, so trimming cannot change the result when discarding)
+        if (count > 0 && buf[count - 1] == '\n') {
+            buf[count - 1] = '\0';
+            count--;
+        }
     }
 
-    return count > 0 ? 1 : 0;
+    if (count == 0) return fail_with(ch, MY_SCANF_ERR_INVALID);
+    return 1;
 }
 
-// Parses boolean-like textual values (%B).
-// RETURN VALUE:
-//   1 if a valid boolean token was parsed
-//   0 otherwise
-// Accepts common true/false spellings and numeric equivalents.
-int scan_bool(int *value) {
-    skip_whitespace();
-
-    char buf[256];
-    if (!scan_string(buf, 255)) {
-        *value = 0;
-        return 0;
+// Parses the body of a %[...] scanset starting just after '['.
+// A leading '^' negates the set, a leading ']' is a member, and "a-z"
+// denotes a byte range. In UTF-8 mode non-ASCII members are kept as code
+// points so a multi-byte character is tested whole.
+// Returns a pointer to the closing ']' (or the terminating NUL).
+static const char *parse_scanset(const char *p, scanset *set) {
+    memset(set, 0, sizeof(*set));
+    if (*p == '^') { set->negated = 1; p++; }
+
+    int first = 1;
+    while (*p && (*p != ']' || first)) {
+        unsigned char lo = (unsigned char)*p;
+        if (cur->utf8 && lo >= 0x80) {
+            int cp = utf8_decode_str(&p);
+            if (set->cp_count < SCANSET_MAX_CODEPOINTS) set->codepoints[set->cp_count++] = cp;
+        } else if (p[1] == '-' && p[2] && p[2] != ']' && (unsigned char)p[2] >= lo) {
+            for (int c = lo; c <= (unsigned char)p[2]; c++)
+                set->bytes[c >> 3] |= (unsigned char)(1u << (c & 7));
+            p += 3;
+        } else {
+            set->bytes[lo >> 3] |= (unsigned char)(1u << (lo & 7));
+            p++;
+        }
+        first = 0;
     }
+    return p;
+}
 
-    // True values
-    if (str_eq_ignore_case(buf, "true") ||
-        str_eq_ignore_case(buf, "yes")  ||
-        str_eq_ignore_case(buf, "on")   ||
-        strcmp(buf, "1") == 0) {
-        *value = 1;
+// Is byte `ch` (or, in UTF-8 mode, code point `cp` >= 0x80) in the set?
+static int scanset_has(const scanset *set, int cp) {
+    int listed = 0;
+    if (cp < 256 && !(cur->utf8 && cp >= 0x80))
+        listed = (set->bytes[cp >> 3] >> (cp & 7)) & 1;
+    else
+        for (int i = 0; i < set->cp_count; i++)
+            if (set->codepoints[i] == cp) { listed = 1; break; }
+    return listed ^ set->negated;
+}
+
+// Reads the longest run of characters in the scanset (%[...]).
+// Returns 1 on successful conversion (at least one character matched).
+// Does not skip leading whitespace. A NULL buf discards the run (%*[...]).
+int scan_scanset(char *buf, int max_width, const scanset *set) {
+    int ch = 0, count = 0;
+
+    if (cur->mem && !cur->utf8) {
+        // Memory source: find the run with bitmap tests, then copy it once
+        const unsigned char *p = cur->pos;
+        size_t limit = (size_t)(cur->end - p) < (size_t)max_width ? (size_t)(cur->end - p) : (size_t)max_width;
+        size_t n = 0;
+        while (n < limit && (((set->bytes[p[n] >> 3] >> (p[n] & 7)) & 1) ^ set->negated)) n++;
+        if (buf) {
+            memcpy(buf, p, n);
+            buf[n] = '\0';
+        }
+        skip_view(n);
+        if (n == 0) return fail_with(peek_char(), MY_SCANF_ERR_INVALID);
+        return 1;
+    }
+
+    while (count < max_width && (ch = next_char()) != EOF) {
+        unsigned char seq[4];
+        int len = 1, cp = ch;
+        seq[0] = (unsigned char)ch;
+        if (cur->utf8 && ch >= 0x80) {
+            cp = utf8_read(ch, seq, &len);
+            if (cp < 0) {
+                unget_bytes(seq, len);
+                if (buf) buf[count] = '\0';
+                set_error(MY_SCANF_ERR_ENCODING);
+                return 0;
+            }
+        }
+        if (!scanset_has(set, cp) || count + len > max_width) {
+            unget_bytes(seq, len);
+            break;
+        }
+        if (buf) memcpy(buf + count, seq, len);
+        count += len;
+    }
+
+    if (buf) buf[count] = '\0';
+    if (count == 0) return fail_with(ch, MY_SCANF_ERR_INVALID);
+    return 1;
+}
+
+/* =========================
+   CSV FIELDS
+   ========================= */
+// Finds where the CSV field starting at p ends: the first ',' or '\n'
+// outside quotes, or `end`. Only a field that starts with '"' is quoted.
+// Quoted regions come from the prefix XOR of the 64-byte quote mask, carried
+// across blocks, so commas and newlines inside quotes never stop the field
+// and doubled quotes ("") need no special case. *quotes receives the number
+// of '"' bytes in the field.
+static const unsigned char *csv_field_end(const unsigned char *p, const unsigned char *end, int *quotes) {
+    int quoted = (p < end && *p == '"');
+    uint64_t carry = 0;         // All ones while a block boundary is inside quotes
+    *quotes = 0;
+
+    for (const unsigned char *base = p; base < end; base += 64) {
+        unsigned char tail[64];
+        const unsigned char *blk = base;
+        if (end - base < 64) {              // Zero padding never matches
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, base, end - base);
+            blk = tail;
+        }
+
+        uint64_t stop = byte_mask64(blk, ',') | byte_mask64(blk, '\n');
+        uint64_t q = 0;
+        if (quoted) {
+            q = byte_mask64(blk, '"');
+            uint64_t inside = prefix_xor(q) ^ carry;
+            stop &= ~inside;
+            carry = (uint64_t)((int64_t)inside >> 63);
+        }
+        if (stop) {
+            *quotes += __builtin_popcountll(q & ((stop & -stop) - 1));
+            return base + __builtin_ctzll(stop);
+        }
+        *quotes += __builtin_popcountll(q);
+    }
+    return end;
+}
+
+// Field content between p and e, dropping the '\r' of a "\r\n" record end.
+// Returns 1 and sets *view when the content can be used in place: an unquoted
+// field, or a quoted one whose only quotes are the enclosing pair.
+static int csv_view(const unsigned char *p, const unsigned char *e, int at_record_end,
+                    int quotes, const unsigned char **view, size_t *len) {
+    if (at_record_end && e > p && e[-1] == '\r') e--;
+    if (quotes == 0 || *p != '"') {
+        *view = p;
+        *len = e - p;
+        return 1;
+    }
+    if (quotes == 2 && e - p >= 2 && e[-1] == '"') {
+        *view = p + 1;
+        *len = e - p - 2;
+        return 1;
+    }
+    return 0;
+}
+
+// Unescapes a quoted field [p, e) into out (at most max bytes):
+// the enclosing quotes are dropped and each "" becomes ".
+// Returns the number of bytes written.
+static size_t csv_unescape(const unsigned char *p, const unsigned char *e, int at_record_end,
+                           char *out, size_t max) {
+    size_t n = 0;
+    if (at_record_end && e > p && e[-1] == '\r') e--;
+    for (p++; p < e; p++) {
+        if (*p == '"') {
+            if (p + 1 < e && p[1] == '"') p++;  // Escaped quote
+            else continue;                       // Closing quote
+        }
+        if (n < max) out[n] = (char)*p;
+        n++;
+    }
+    return n < max ? n : max;
+}
+
+int my_csv_fields(const char *rec, size_t len, my_scanf_view *fields, int max_fields, char *scratch) {
+    const unsigned char *p = (const unsigned char *)rec, *end = p + len;
+    int n = 0;
+
+    for (;;) {
+        int quotes;
+        const unsigned char *e = csv_field_end(p, end, &quotes);
+        int at_record_end = (e == end || *e == '\n');
+        if (n < max_fields) {
+            const unsigned char *view;
+            size_t view_len;
+            if (csv_view(p, e, at_record_end, quotes, &view, &view_len)) {
+                fields[n].ptr = (const char *)view;       // Zero-copy
+                fields[n].len = view_len;
+            } else {
+                fields[n].ptr = scratch;
+                fields[n].len = csv_unescape(p, e, at_record_end, scratch, (size_t)(e - p));
+                scratch += fields[n].len;
+            }
+        }
+        n++;
+        if (at_record_end) return n;
+        p = e + 1;                                   // Past the ','
+    }
+}
+
+// Reads one RFC 4180 CSV field (%qD). A quoted field may contain commas,
+// newlines and doubled quotes (""), which are unescaped in the same pass.
+// The separating ',' is consumed; a record-ending '\n' stays in the input.
+// Fields longer than max_width are truncated but consumed whole.
+// A NULL buf discards the field (%*qD).
+// RETURN VALUE:
+//   1 on successful read (an empty field after a ',' counts)
+//   0 if no field is present (empty line)
+//  -1 on EOF with no input
+int scan_csv_field(char *buf, int max_width) {
+    size_t count = 0;
+    int after_sep = cur->csv_after_sep, ended_at_sep = 0, quoted = 0;
+
+    if (cur->mem) {
+        // Memory source: locate the field with SIMD masks, then copy once
+        if (cur->pos == cur->end) {
+            if (buf) buf[0] = '\0';
+            cur->csv_after_sep = 0;
+            set_error(MY_SCANF_ERR_EOF);
+            return -1;
+        }
+        int quotes;
+        const unsigned char *start = cur->pos;
+        const unsigned char *e = csv_field_end(start, cur->end, &quotes);
+        int at_record_end = (e == cur->end || *e == '\n');
+        const unsigned char *view;
+        if (csv_view(start, e, at_record_end, quotes, &view, &count)) {
+            if (count > (size_t)max_width) count = max_width;
+            if (buf) memcpy(buf, view, count);
+        } else {
+            count = csv_unescape(start, e, at_record_end, buf, buf ? (size_t)max_width : 0);
+        }
+        quoted = (*start == '"');
+        ended_at_sep = !at_record_end;
+        skip_view((size_t)(e - start) + ended_at_sep);
+    } else {
+        // Stream source: quote state machine, one byte at a time
+        int ch = next_char();
+        if (ch == EOF) {
+            if (buf) buf[0] = '\0';
+            cur->csv_after_sep = 0;
+            set_error(MY_SCANF_ERR_EOF);
+            return -1;
+        }
+        int in_quotes = quoted = (ch == '"');
+        if (!quoted) unget_char(ch);
+        size_t n = 0;
+        int last = 0;
+        while ((ch = next_char()) != EOF) {
+            if (in_quotes && ch == '"') {
+                int next = next_char();
+                if (next != '"') {              // Closing quote
+                    in_quotes = 0;
+                    unget_char(next);
+                    continue;
+                }
+            } else if (!in_quotes && ch == ',') {
+                ended_at_sep = 1;
+                break;
+            } else if (!in_quotes && ch == '\n') {
+                unget_char(ch);
+                break;
+            }
+            if (buf && n < (size_t)max_width) buf[n] = (char)ch;
+            last = ch;
+            n++;
+        }
+        count = n < (size_t)max_width ? n : (size_t)max_width;
+        if (!ended_at_sep && count > 0 && count == n && last == '\r') count--;
+    }
+
+    if (buf) buf[count] = '\0';
+    cur->csv_after_sep = ended_at_sep;
+
+    // Nothing before the end of the record and no ',' before it → no field
+    if (count == 0 && !quoted && !ended_at_sep && !after_sep)
+        return fail_with(peek_char(), MY_SCANF_ERR_INVALID);
+    return 1;
+}
+
+// Parses boolean-like textual values (%B).
+// RETURN VALUE:
+//   1 if a valid boolean token was parsed
+//   0 otherwise
+// Accepts common true/false spellings and numeric equivalents.
+int scan_bool(int *value) {
+    skip_whitespace();
+    long long start = cur->offset;   // Report a bad token at its first byte
+
+    // The longest spelling is "false": only the first 7 bytes of the token
+    // are kept, the rest of a longer (and so invalid) token is skipped
+    char *buf = scratch_reserve(8);
+    if (!buf || !scan_string(buf, 7)) {
+        *value = 0;
+        return 0;
+    }
+    int next = peek_char();
+    if (next != EOF && !IS_SPACE(next)) scan_string(NULL, INT_MAX);
+
+    // True values
+    if (str_eq_ignore_case(buf, "true") ||
+        str_eq_ignore_case(buf, "yes")  ||
+        str_eq_ignore_case(buf, "on")   ||
+        strcmp(buf, "1") == 0) {
+        *value = 1;
         return 1;
     }
 
@@ -485,166 +1501,2594 @@ int scan_bool(int *value) {
     }
 
     *value = 0;
+    fail_with(0, MY_SCANF_ERR_INVALID);
+    cur->err.offset = start;
     return 0;
 }
 
 /* =========================
-   my_scanf
+   TIMESTAMPS & ADDRESSES
    ========================= */
-// Custom scanf implementation supporting standard conversions and extensions (%b, %D, %B).
-// Returns number of successfully assigned input items.
-// Returns 0 if no assignments could be made, EOF if input ended before any assignments.
-int my_scanf(const char *format, ...) {
-    // Variable argument list
-    va_list args;
-    // Initialize it
-    va_start(args, format);
-    // Count of successfully assigned conversions
-    int assigned = 0;
+// %T and %I read fixed-shape fields in one conversion instead of a chain of
+// %d's. On memory input the digit groups are checked and combined eight
+// bytes at a time (SWAR); stdin goes through the same layout byte by byte.
+
+// "YYYY-MM-DDTHH:MM:SS": 'D' is a digit, 'T' also accepts 't' or ' '.
+static const char ts_layout[] = "DDDD-DD-DDTDD:DD:DD";
+#define TS_FIXED_LEN 19
+
+static int ts_layout_ok(int i, int ch) {
+    switch (ts_layout[i]) {
+        case 'D': return IS_DIGIT(ch);
+        case 'T': return ch == 'T' || ch == 't' || ch == ' ';
+        default:  return ch == ts_layout[i];
+    }
+}
 
-    // Loop through each character of the format string
-    for (const char *p = format; *p; p++) {
-        // Conversion specifier
-        if (*p == '%') {
-            p++;                // Move past '%'
-            int suppress = 0;   // Suppression flag (if '*' is present)
-
-            // Check for suppression operator '*'
-            if (*p == '*') { suppress = 1; p++; }
-
-            // Handle literal "%%" (matches a single '%' in input)
-            if (*p == '%') {
-                int ch = getchar();                 // Read next input character
-                if (ch == EOF) {                    // End of input
-                    va_end(args);
-                    return assigned ? assigned : EOF;
-                }
-                if (ch != '%') {                    // Did not match '%'
-                    ungetc(ch, stdin);             // Put character back
-                    va_end(args);
-                    return assigned ? assigned : 0;
-                }
-                continue;                           // Matched literal '%', continue
-            }
+// Splits a "YYYY-MM-DDTHH:MM:SS" block into year, month, day, hour, minute
+// and second. The first 16 bytes are two words: digits are validated with
+// one SWAR test per word and turned into two-digit numbers with one multiply.
+// Returns 0 if the block does not have that shape.
+static int ts_fields(const unsigned char *p, int f[6]) {
+    const uint64_t a_digits = 0x00FFFF00FFFFFFFFULL;    // "YYYY-MM-"
+    const uint64_t b_digits = 0xFFFF00FFFF00FFFFULL;    // "DDTHH:MM"
+    uint64_t a = load64(p), b = load64(p + 8);
+
+    if ((swar_digits(a) & a_digits) != (a_digits & SWAR_HIGH) ||
+        (swar_digits(b) & b_digits) != (b_digits & SWAR_HIGH) ||
+        (a & ~a_digits) != 0x2D00002D00000000ULL ||     // '-' in bytes 4 and 7
+        (b & 0x0000FF0000000000ULL) != 0x00003A0000000000ULL ||  // ':' in byte 13
+        !ts_layout_ok(10, p[10]) || p[16] != ':' || !IS_DIGIT(p[17]) || !IS_DIGIT(p[18]))
+        return 0;
 
-            // Optional field width parsing (e.g., %10s)
-            int width = 0;
-            while (isdigit(*p)) {
-                width = width * 10 + (*p - '0');  // Accumulate width
-                p++;
-            }
+    uint64_t pa = swar_pairs((a & a_digits) - (SWAR_ONES * '0' & a_digits));
+    uint64_t pb = swar_pairs((b & b_digits) - (SWAR_ONES * '0' & b_digits));
+    f[0] = (int)(pa & 0xFF) * 100 + (int)(pa >> 16 & 0xFF);
+    f[1] = (int)(pa >> 40 & 0xFF);
+    f[2] = (int)(pb & 0xFF);
+    f[3] = (int)(pb >> 24 & 0xFF);
+    f[4] = (int)(pb >> 48 & 0xFF);
+    f[5] = (p[17] - '0') * 10 + (p[18] - '0');
+    return 1;
+}
 
-            // Optional length modifiers: h, hh, l, ll
-            char length[3] = "";
-            if (*p == 'h' && *(p+1) == 'h') { strcpy(length,"hh"); p+=2; }
-            else if (*p == 'h') { strcpy(length,"h"); p++; }
-            else if (*p == 'l' && *(p+1) == 'l') { strcpy(length,"ll"); p+=2; }
-            else if (*p == 'l') { strcpy(length,"l"); p++; }
-
-            char spec = *p;           // Conversion specifier character
-            if (!spec) break;         // End of format string
-
-            // Switch based on conversion specifier
-            switch (spec) {
-                case 'd': { // Signed decimal integer
-                    if (suppress) {
-                        int discard;
-                        if (!scan_int(&discard, width, length)) goto end;
-                    } else {
-                        void *arg = va_arg(args, void*);
-                        if (!scan_int(arg, width, length)) goto end;
-                        assigned++;
-                    }
-                    break;
-                }
+// Days from 1970-01-01 to the given proleptic Gregorian date.
+static long long days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = (int)(y - era * 400);
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
 
-                case 'x': {
-                    // Hexadecimal integer
-                    if (suppress) {
-                        int discard;
-                        if (!scan_hex(&discard, width, length)) goto end;
-                    } else {
-                        void *arg = va_arg(args, void*);
-                        if (!scan_hex(arg, width, length)) goto end;
-                        assigned++;
-                    }
-                    break;
-                }
-                case 'b': { // Binary integer (custom %b)
-                    int tmp;
-                    int *arg = suppress ? &tmp : va_arg(args,int*);
-                    int ret = scan_binary(arg);       // Returns 1 on success, 0/negative on failure
-                    if (ret <= 0) goto end;          // Stop on failure or EOF
-                    if (!suppress) assigned++;
-                    break;
-                }
-                case 'f': { // Floating-point number
-                    if (strcmp(length,"l") == 0 || strcmp(length,"ll") == 0) {
-                        double tmp;
-                        double *arg = suppress ? &tmp : va_arg(args,double*);
-                        if (!scan_float(arg,width)) goto end;
-                        if (!suppress) assigned++;
-                    } else {
-                        double tmp;
-                        float *arg = suppress ? NULL : va_arg(args,float*);
-                        if (!scan_float(&tmp,width)) goto end;
-                        if (!suppress) *arg = (float)tmp; // Assign float value
-                        if (!suppress) assigned++;
-                    }
-                    break;
-                }
-                case 'c': { // Single character(s)
-                    char tmp[8];
-                    char *arg = suppress ? tmp : va_arg(args,char*);
-                    if (!scan_char(arg,width)) goto end;
-                    if (!suppress) assigned++;
-                    break;
-                }
-                case 's': { // String
-                    char tmp[256];
-                    char *arg = suppress ? tmp : va_arg(args,char*);
-                    if (!scan_string(arg,width ? width : 256)) goto end;
-                    if (!suppress) assigned++;
-                    break;
-                }
-                case 'D': { // Delimited string
-                    char tmp[256];
-                    char *arg = suppress ? tmp : va_arg(args,char*);
-                    int w = width ? width : 256;
-                    const char *delimiter = ",";           // Default delimiter
-                    int ret = scan_delimited_string(arg, w, delimiter);
-                    if (ret <= 0) goto end;               // Stop on failure or EOF
-                    if (!suppress) assigned++;
-                    break;
-                }
-                case 'B': { // Boolean
-                    int tmp;
-                    int *arg = suppress ? &tmp : va_arg(args,int*);
-                    if (!scan_bool(arg)) goto end;
-                    if (!suppress) assigned++;
-                    break;
-                }
-                default: { // Literal character match
-                    int ch = getchar();
-                    if (ch == EOF) goto end;             // EOF stops reading
-                    if (ch != spec) {                    // Mismatch → stop
-                        ungetc(ch, stdin);
-                        goto end;
-                    }
-                    break;
-                }
-            }
-        } else if (isspace(*p)) {
-            skip_whitespace(); // Any whitespace in format matches any whitespace in input
+static int days_in_month(int y, int m) {
+    static const unsigned char days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return days[m - 1] + (m == 2 && leap);
+}
+
+// Reads exactly two digits. Returns 0 (with the error recorded) otherwise.
+static int read_two_digits(int *value) {
+    int hi = next_char();
+    if (!IS_DIGIT(hi)) { unget_char(hi); return fail_with(hi, MY_SCANF_ERR_INVALID); }
+    int lo = next_char();
+    if (!IS_DIGIT(lo)) { unget_char(lo); return fail_with(lo, MY_SCANF_ERR_INVALID); }
+    *value = (hi - '0') * 10 + (lo - '0');
+    return 1;
+}
+
+// Reads an ISO-8601 timestamp "YYYY-MM-DDTHH:MM:SS[.fff][Z|+HH:MM|+HHMM|+HH]"
+// (no zone means UTC) as nanoseconds since the Unix epoch.
+// Fraction digits past nanoseconds are truncated; instants outside the
+// int64 range saturate like integer overflow.
+// Returns 1 on successful conversion.
+int scan_timestamp(long long *ns) {
+    skip_whitespace();
+    long long start = cur->offset;
+    int f[6];
+
+    if (cur->mem && cur->end - cur->pos >= TS_FIXED_LEN && ts_fields(cur->pos, f)) {
+        skip_view(TS_FIXED_LEN);
+    } else {
+        // Byte-by-byte, so a bad field stops at the offending character
+        unsigned char buf[TS_FIXED_LEN];
+        for (int i = 0; i < TS_FIXED_LEN; i++) {
+            int ch = next_char();
+            if (!ts_layout_ok(i, ch)) { unget_char(ch); return fail_with(ch, MY_SCANF_ERR_INVALID); }
+            buf[i] = (unsigned char)ch;
+        }
+        ts_fields(buf, f);
+    }
+
+    // Optional fraction of a second
+    long long frac = 0;
+    int ch = next_char();
+    if (ch == '.' || ch == ',') {
+        int digits = 0;
+        while (IS_DIGIT(ch = next_char())) {
+            if (digits < 9) frac = frac * 10 + (ch - '0');
+            digits++;
+        }
+        if (digits == 0) { unget_char(ch); return fail_with(ch, MY_SCANF_ERR_INVALID); }
+        for (; digits < 9; digits++) frac *= 10;
+    }
+
+    // Optional zone designator
+    int zone = 0;
+    if (ch == 'Z' || ch == 'z') {
+        ch = next_char();
+    } else if (ch == '+' || ch == '-') {
+        int sign = ch == '-' ? -1 : 1, hh, mm = 0;
+        if (!read_two_digits(&hh)) return 0;
+        ch = next_char();
+        if (ch == ':' || IS_DIGIT(ch)) {
+            if (IS_DIGIT(ch)) unget_char(ch);
+            if (!read_two_digits(&mm)) return 0;
+            ch = next_char();
+        }
+        if (hh > 23 || mm > 59) {
+            unget_char(ch);
+            fail_with(0, MY_SCANF_ERR_INVALID);
+            cur->err.offset = start;
+            return 0;
+        }
+        zone = sign * (hh * 3600 + mm * 60);
+    }
+    unget_char(ch);
+
+    if (f[1] < 1 || f[1] > 12 || f[2] < 1 || f[2] > days_in_month(f[0], f[1]) ||
+        f[3] > 23 || f[4] > 59 || f[5] > 60) {
+        fail_with(0, MY_SCANF_ERR_INVALID);
+        cur->err.offset = start;        // Report the field, not the byte after it
+        return 0;
+    }
+
+    long long secs = days_from_civil(f[0], f[1], f[2]) * 86400 +
+                     f[3] * 3600 + f[4] * 60 + f[5] - zone;
+    long long value;
+    if (__builtin_mul_overflow(secs, 1000000000LL, &value) ||
+        __builtin_add_overflow(value, frac, &value)) {
+        value = secs < 0 ? LLONG_MIN : LLONG_MAX;
+        set_overflow(start);
+    }
+    *ns = value;
+    return 1;
+}
+
+#define IPV4_TOKEN_MAX 15       // "255.255.255.255"
+#define IPV6_TOKEN_MAX 45       // "ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255"
+
+// Parses a dotted quad (len <= 15 bytes in tok, zero-padded to 16) into a
+// host-order address. Dots and digits are located with SWAR compares over the
+// two words of tok; each octet must be 1-3 digits, at most 255 and without a
+// leading zero, as inet_pton requires. Returns 0 if tok is not an address.
+static int ipv4_from_token(const unsigned char tok[16], int len, uint32_t *addr) {
+    uint64_t lo = load64(tok), hi = load64(tok + 8);
+    unsigned dots = swar_bits(swar_eq(lo, '.')) | swar_bits(swar_eq(hi, '.')) << 8;
+    unsigned digits = swar_bits(swar_digits(lo)) | swar_bits(swar_digits(hi)) << 8;
+    if ((dots | digits) != (1u << len) - 1 || __builtin_popcount(dots) != 3) return 0;
+
+    uint32_t value = 0;
+    unsigned ends = dots | 1u << len;      // Each octet ends at a dot or the end of the token
+    for (int begin = 0, i = 0; i < 4; i++) {
+        int end = __builtin_ctz(ends), n = end - begin;
+        ends &= ends - 1;
+        if (n < 1 || n > 3 || (n > 1 && tok[begin] == '0')) return 0;
+        int octet = 0;
+        for (int k = begin; k < end; k++) octet = octet * 10 + (tok[k] - '0');
+        if (octet > 255) return 0;
+        value = value << 8 | (uint32_t)octet;
+        begin = end + 1;
+    }
+    *addr = value;
+    return 1;
+}
+
+// Parses IPv6 text (RFC 4291: 1-4 hex digits per group, one "::" run of
+// zero groups, optional dotted quad in the last 32 bits) into network order.
+static int ipv6_from_token(const unsigned char *tok, int len, unsigned char out[16]) {
+    unsigned char bytes[16];
+    int n = 0, gap = -1, i = 0;
+
+    if (tok[0] == ':') {                // Only valid as the start of "::"
+        if (len < 2 || tok[1] != ':') return 0;
+        gap = 0;
+        i = 2;
+    }
+    while (i < len) {
+        int j = i, group = 0;
+        while (j < len && j - i < 5 && digit_table[tok[j]] < 16) group = group * 16 + digit_table[tok[j++]];
+
+        if (j < len && tok[j] == '.') { // Trailing dotted quad
+            unsigned char quad[16] = {0};
+            uint32_t v4;
+            if (n > 12 || len - i > IPV4_TOKEN_MAX) return 0;
+            memcpy(quad, tok + i, len - i);
+            if (!ipv4_from_token(quad, len - i, &v4)) return 0;
+            for (int k = 0; k < 4; k++) bytes[n++] = (unsigned char)(v4 >> (24 - 8 * k));
+            i = len;
+            break;
+        }
+        if (j == i || j - i > 4 || n == 16) return 0;
+        bytes[n++] = (unsigned char)(group >> 8);
+        bytes[n++] = (unsigned char)group;
+        if ((i = j) == len) break;
+
+        if (tok[i++] != ':' || i == len) return 0;     // Group separator, not at the end
+        if (tok[i] == ':') {
+            if (gap >= 0) return 0;     // At most one "::"
+            gap = n;
+            i++;
+        }
+    }
+
+    if (gap >= 0) {
+        if (n == 16) return 0;          // "::" must stand for at least one group
+        memset(out, 0, 16);
+        memcpy(out, bytes, gap);
+        memcpy(out + 16 - (n - gap), bytes + gap, n - gap);
+    } else {
+        if (n != 16) return 0;
+        memcpy(out, bytes, 16);
+    }
+    return 1;
+}
+
+static int is_address_char(int ch, int v6) {
+    return IS_DIGIT(ch) || ch == '.' || (v6 && (ch == ':' || digit_table[(unsigned char)ch] < 16));
+}
+
+// Reads an IPv4 address into *(uint32_t *)dest in host order, or with v6 an
+// IPv6 address into 16 bytes in network order (the layout inet_pton uses).
+// Returns 1 on successful conversion.
+int scan_address(void *dest, int v6) {
+    skip_whitespace();
+    long long start = cur->offset;
+
+    // Collect the run of address characters; one byte past the longest
+    // address tells a too-long run apart from a valid one
+    unsigned char tok[IPV6_TOKEN_MAX + 1] = {0};
+    int cap = (v6 ? IPV6_TOKEN_MAX : IPV4_TOKEN_MAX) + 1, len = 0, ch = 0;
+    while (len < cap && is_address_char(ch = next_char(), v6)) tok[len++] = (unsigned char)ch;
+    if (len < cap) unget_char(ch);
+    if (len == 0) return fail_with(ch, MY_SCANF_ERR_INVALID);
+
+    int ok = len < cap &&
+             (v6 ? ipv6_from_token(tok, len, dest) : ipv4_from_token(tok, len, dest));
+    if (!ok) {
+        fail_with(0, MY_SCANF_ERR_INVALID);
+        cur->err.offset = start;
+        return 0;
+    }
+    return 1;
+}
+
+/* =========================
+   CONVERSION HANDLERS
+   ========================= */
+// Every conversion, built-in or registered, is a my_scanf_handler: it reads
+// its field from the scanner and stores it through dest (NULL when the
+// conversion is suppressed with '*'). Handlers return nonzero on success and
+// 0 on failure, after recording why with fail_with / my_scanf_fail.
+
+#define CONV_NO_ARG    1    // Takes no argument (literal match for an unknown specifier)
+#define CONV_NO_ASSIGN 2    // Not counted as an assigned item (%n)
+
+typedef struct {
+    my_scanf_handler fn;
+    int flags;
+} conversion_entry;
+
+// Adaptive fast path state of one directive (see FAST PATHS).
+typedef struct {
+    unsigned char kind;         // SHAPE_NONE, SHAPE_DIGITS or SHAPE_DECIMAL
+    unsigned char mode;         // SHAPE_FAST or SHAPE_GENERAL
+    unsigned short count;       // SHAPE_FAST: fields in this window; SHAPE_GENERAL: fields left to rest
+    unsigned short misses;      // Fast path fallbacks in this window
+    unsigned long long max;     // SHAPE_DIGITS: largest value the destination holds
+} field_shape;
+
+// Consecutive literal bytes of a format ("),(", "%%") compile into one
+// directive of up to LITERAL_RUN bytes, matched with a single memcmp on
+// memory sources.
+#define LITERAL_RUN 16
+
+// A compiled directive. The spec comes first so built-in handlers can get
+// back from the my_scanf_spec they are given to the directive (for %[...]).
+typedef struct {
+    my_scanf_spec spec;
+    int kind;                   // DIR_* below
+    char literal[LITERAL_RUN];  // DIR_LITERAL: run of bytes to match
+    int literal_len;
+    my_scanf_handler fn;        // DIR_CONVERSION: resolved from the table at compile time
+    int flags;                  // CONV_* flags of the handler
+    scanset *set;               // %[...]: parsed member set
+    field_shape shape;          // %d / %u / %f: adaptive fast path
+} directive;
+
+enum { DIR_CONVERSION, DIR_LITERAL, DIR_SPACE, DIR_STOP };
+
+static int conv_integer(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    char c = spec->spec;
+    long long discard;
+    void *arg = dest ? dest : &discard;
+    int base = (c == 'd' || c == 'u') ? 10 :
+               (c == 'x' || c == 'X') ? 16 :
+               (c == 'o') ? 8 : (c == 'i') ? 0 : 2;
+    int is_unsigned = (c == 'u' || c == 'o' || c == 'x' || c == 'X');
+    if (!scan_integer(arg, spec->width, spec->length, base, is_unsigned)) {
+        if (c == 'b' && dest) store_signed_integer(dest, spec->length, 0);  // %b reports 0 on failure
+        return 0;
+    }
+    return 1;
+}
+
+static int conv_pointer(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    unsigned long long addr;
+    if (!scan_integer(&addr, spec->width, "ll", 16, 1)) return 0;
+    if (dest) *(void **)dest = (void *)(uintptr_t)addr;
+    return 1;
+}
+
+static int conv_count(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    if (dest) store_signed_integer(dest, spec->length, cur->offset - cur->call_start);
+    return 1;
+}
+
+static void store_float(void *dest, const char *length, double value) {
+    if (strcmp(length, "L") == 0) *(long double *)dest = value;
+    else if (strcmp(length, "l") == 0 || strcmp(length, "ll") == 0) *(double *)dest = value;
+    else *(float *)dest = (float)value;
+}
+
+static int conv_float(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    if (strcmp(spec->length, "L") == 0) {
+        long double value;
+        if (!scan_long_double(&value, spec->width)) return 0;
+        if (dest) *(long double *)dest = value;
+        return 1;
+    }
+    double tmp;
+    if (!scan_float(&tmp, spec->width)) return 0;
+    if (dest) store_float(dest, spec->length, tmp);
+    return 1;
+}
+
+// String conversions pass a NULL dest straight through: a suppressed field
+// is skipped without being copied anywhere, whatever its length.
+static int conv_char(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    return scan_char(dest, spec->width);
+}
+
+static int conv_string(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    return scan_string(dest, spec->width ? spec->width : INT_MAX);
+}
+
+static int conv_delimited(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    int w = spec->width ? spec->width : INT_MAX;
+    const char *delimiter = ",";           // Default delimiter
+    int ret = spec->csv ? scan_csv_field(dest, w)
+                        : scan_delimited_string(dest, w, delimiter);
+    return ret > 0;                         // Stop on failure or EOF
+}
+
+static int conv_scanset(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    const directive *d = (const directive *)spec;
+    return scan_scanset(dest, spec->width ? spec->width : INT_MAX, d->set);
+}
+
+static int conv_bool(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx; (void)spec;
+    int tmp;
+    return scan_bool(dest ? dest : &tmp);
+}
+
+static int conv_timestamp(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx; (void)spec;
+    long long tmp;
+    return scan_timestamp(dest ? dest : &tmp);
+}
+
+static int conv_address(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx;
+    unsigned char tmp[16];
+    return scan_address(dest ? dest : tmp, strcmp(spec->length, "l") == 0);
+}
+
+// Unknown specifiers match themselves literally, as before the table existed.
+static int conv_literal(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)ctx; (void)dest;
+    int ch = next_char();
+    if (ch == EOF) return fail_with(EOF, MY_SCANF_ERR_EOF);
+    if (ch != spec->spec) {
+        unget_char(ch);
+        return fail_with(ch, MY_SCANF_ERR_LITERAL);
+    }
+    return 1;
+}
+
+static const conversion_entry builtin_conversions[128] = {
+    ['d'] = { conv_integer },  ['i'] = { conv_integer },  ['u'] = { conv_integer },
+    ['o'] = { conv_integer },  ['x'] = { conv_integer },  ['X'] = { conv_integer },
+    ['b'] = { conv_integer },
+    ['p'] = { conv_pointer },
+    ['n'] = { conv_count, CONV_NO_ASSIGN },
+    ['f'] = { conv_float },    ['F'] = { conv_float },    ['e'] = { conv_float },
+    ['E'] = { conv_float },    ['g'] = { conv_float },    ['G'] = { conv_float },
+    ['a'] = { conv_float },    ['A'] = { conv_float },
+    ['c'] = { conv_char },
+    ['s'] = { conv_string },
+    ['D'] = { conv_delimited },
+    ['['] = { conv_scanset },
+    ['B'] = { conv_bool },
+    ['T'] = { conv_timestamp },
+    ['I'] = { conv_address },
+};
+
+// Handlers added with my_scanf_register; they take precedence over the built-ins.
+static my_scanf_handler custom_conversions[128];
+
+// Characters that are part of the directive syntax and cannot name a conversion.
+static int reserved_spec(int c) {
+    return c <= 0 || c >= 128 || c == '%' || c == '*' || c == '[' || IS_DIGIT(c) ||
+           strchr("qhljztL", c) != NULL;
+}
+
+/* =========================
+   FAST PATHS
+   ========================= */
+// Most numeric fields in real data share one shape: a %d or %u that is a
+// short run of digits with no sign, or a %f that is a plain decimal of at
+// most 15 digits with no exponent. A %d / %u / %f directive without a width
+// parses its field with a specialized parser that checks for that shape
+// first and, when the check fails, hands the field to the general
+// conversion. Both produce the same result; only the work differs.
+// Directives whose fields mostly miss the shape (more than SHAPE_DEMOTE of
+// a SHAPE_WINDOW-field window) are demoted to the general path for
+// SHAPE_BACKOFF fields, then try again. my_scanf_get_stats() reports the
+// counts.
+#define SHAPE_WINDOW  64
+#define SHAPE_DEMOTE  8
+#define SHAPE_BACKOFF 4096
+
+enum { SHAPE_NONE, SHAPE_DIGITS, SHAPE_DECIMAL };
+enum { SHAPE_FAST, SHAPE_GENERAL };
+
+static _Thread_local my_scanf_stats stats;
+
+const my_scanf_stats *my_scanf_get_stats(void) {
+    return &stats;
+}
+
+void my_scanf_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+// Gives a freshly compiled directive its fast path, if it has one.
+static void assign_shape(directive *d) {
+    char c = d->spec.spec;
+    if (d->spec.width) return;
+    if (d->fn == conv_integer && (c == 'd' || c == 'u')) {
+        long long min;
+        integer_limits(d->spec.length, c == 'u', &min, &d->shape.max);
+        d->shape.kind = SHAPE_DIGITS;
+    } else if (d->fn == conv_float && strchr("fFeEgG", c) && strcmp(d->spec.length, "L") != 0) {
+        d->shape.kind = SHAPE_DECIMAL;
+    }
+}
+
+// %d / %u: leading ASCII whitespace, then unsigned digits. On memory input
+// up to 8 digits are converted in one step. Returns -1 without consuming
+// the field if it starts with anything else (a sign, a Unicode space).
+static int fast_digits(const directive *d, void *dest) {
+    unsigned long long value = 0;
+    long long start;
+    int ch, overflow = 0;
+
+    if (cur->mem) {
+        const unsigned char *p = cur->pos, *end = cur->end;
+        p += space_span(p, end);
+        if (p == end || !IS_DIGIT(*p)) return -1;
+        const unsigned char *digits = p;
+        int n;
+        if (end - p >= 8 && (n = swar_digit_run(load64(p))) < 8) {
+            value = swar_number(load64(p), n);
+            p += n;
         } else {
-            // Literal character in format
-            int ch = getchar();
-            if (ch == EOF) goto end;
-            if (ch != *p) { ungetc(ch, stdin); goto end; }
+            for (; p < end && IS_DIGIT(*p) && p - digits < 19; p++) value = value * 10 + (unsigned)(*p - '0');
+        }
+        skip_view(p - cur->pos);
+        start = cur->offset - (p - digits);
+    } else {
+        while ((ch = next_char()) != EOF && IS_SPACE(ch)) {}
+        if (!IS_DIGIT(ch)) {
+            unget_char(ch);
+            return -1;
+        }
+        start = cur->offset - 1;
+        int n = 1;
+        value = (unsigned)(ch - '0');
+        while (n < 19 && IS_DIGIT(ch = next_char())) {
+            value = value * 10 + (unsigned)(ch - '0');
+            n++;
         }
+        unget_char(ch);
     }
+    // Past 19 digits the value may overflow: finish with the checked loop
+    scan_digits(&value, 10, &overflow);
 
-end:
-    va_end(args); // Clean up argument list
-    return assigned ? assigned : (feof(stdin) ? EOF : 0); // Return assignments, 0, or EOF
-}
\ No newline at end of file
+    if (value > d->shape.max) {
+        value = d->shape.max;
+        overflow = 1;
+    }
+    if (dest) {
+        if (d->spec.spec == 'u') store_unsigned_integer(dest, d->spec.length, value);
+        else store_signed_integer(dest, d->spec.length, (long long)value);
+    }
+    if (overflow) set_overflow(start);
+    return 1;
+}
+
+// %f on memory input: leading ASCII whitespace, an optional '-', then at
+// most 15 digits with an optional '.', not followed by an exponent or a hex
+// prefix. The value is the same mantissa * 10^exp10 the general path
+// computes. Returns -1 without consuming anything if the field has any
+// other shape.
+static int fast_decimal(const directive *d, void *dest) {
+    const unsigned char *p = cur->pos, *end = cur->end;
+    p += space_span(p, end);
+    int negative = p < end && *p == '-';
+    p += negative;
+
+    uint64_t mantissa = 0;
+    const unsigned char *digits = p;
+    for (; p < end && IS_DIGIT(*p); p++) mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+    int count = (int)(p - digits), exp10 = 0;
+    if (p < end && *p == '.') {
+        const unsigned char *fraction = ++p;
+        for (; p < end && IS_DIGIT(*p); p++) mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        exp10 = -(int)(p - fraction);
+        count -= exp10;
+    }
+    if (count == 0 || count > 15) return -1;
+    if (p < end && ((*p | 0x20) == 'e' || (*p | 0x20) == 'x')) return -1;
+
+    skip_view(p - cur->pos);
+    if (dest) store_float(dest, d->spec.length, decimal_to_double(mantissa, exp10) * (negative ? -1 : 1));
+    return 1;
+}
+
+// %f on a stream, where a field cannot be looked at before it is consumed:
+// scan_float without the width bookkeeping, reading each byte once instead
+// of peeking at it first. Fields that start with a digit, '-' or '.' are
+// parsed to the end here (exponents and hex floats included); anything
+// else (a '+', a Unicode space) is put back for the general path.
+static int fast_decimal_stream(const directive *d, void *dest) {
+    int ch;
+    while ((ch = next_char()) != EOF && IS_SPACE(ch)) {}
+    if (!IS_DIGIT(ch) && ch != '-' && ch != '.') {
+        unget_char(ch);
+        return -1;
+    }
+    int sign = 1;
+    if (ch == '-') {
+        sign = -1;
+        ch = next_char();
+    }
+
+    uint64_t mantissa = 0;
+    int significant = 0, exp10 = 0, digits = 0;
+    double value;
+    if (ch == '0') {
+        digits = 1;
+        if (((ch = next_char()) | 0x20) == 'x') {   // Hex float, as in scan_float
+            if (!scan_hex_float(&value)) return 0;
+            if (dest) store_float(dest, d->spec.length, value * sign);
+            return 1;
+        }
+    }
+    for (; IS_DIGIT(ch); ch = next_char(), digits++)
+        add_decimal_digit(&mantissa, &significant, &exp10, ch - '0', 0);
+    if (ch == '.')
+        for (ch = next_char(); IS_DIGIT(ch); ch = next_char(), digits++)
+            add_decimal_digit(&mantissa, &significant, &exp10, ch - '0', 1);
+    unget_char(ch);
+
+    if (digits == 0) return fail_with(ch, MY_SCANF_ERR_NO_DIGITS);
+    if (!apply_exponent(&exp10)) return 0;
+    if (dest) store_float(dest, d->spec.length, decimal_to_double(mantissa, exp10) * sign);
+    return 1;
+}
+
+// Parses a shaped directive's field, through its fast path when the
+// directive is not resting, and updates its window.
+static int run_shaped(directive *d, void *dest) {
+    field_shape *sh = &d->shape;
+    if (sh->mode == SHAPE_GENERAL) {
+        stats.general++;
+        if (--sh->count == 0) {
+            sh->mode = SHAPE_FAST;
+            sh->misses = 0;
+            stats.promotions++;
+        }
+        return d->fn((my_scanf_ctx *)cur, &d->spec, dest);
+    }
+
+    int r = sh->kind == SHAPE_DIGITS ? fast_digits(d, dest) :
+            cur->mem ? fast_decimal(d, dest) : fast_decimal_stream(d, dest);
+    if (r < 0) {
+        stats.fallback++;
+        sh->misses++;
+    } else {
+        stats.fast++;
+    }
+    if (++sh->count == SHAPE_WINDOW) {
+        sh->count = 0;
+        if (sh->misses > SHAPE_DEMOTE) {
+            sh->mode = SHAPE_GENERAL;
+            sh->count = SHAPE_BACKOFF;
+            stats.demotions++;
+        }
+        sh->misses = 0;
+    }
+    return r >= 0 ? r : d->fn((my_scanf_ctx *)cur, &d->spec, dest);
+}
+
+/* =========================
+   FORMAT COMPILER
+   ========================= */
+// A format string is parsed once into an array of directives, each conversion
+// carrying the handler looked up for its specifier. Compiled formats are kept
+// in a small cache keyed by the format pointer and checked against a copy of
+// its text, so a reused buffer with new contents is recompiled.
+#define FORMAT_CACHE_SIZE 16
+
+typedef struct {
+    const char *key;            // Format pointer the entry was compiled from
+    char *text;                 // Copy of the format text
+    directive *dirs;
+    int count;
+    unsigned generation;        // Value of format_generation when compiled
+    int utf8;                   // UTF-8 mode when compiled (%[ sets depend on it)
+    int busy;                   // Running calls (a handler may scan a nested format)
+} compiled_format;
+
+static _Thread_local compiled_format format_cache[FORMAT_CACHE_SIZE];
+static unsigned format_generation;     // Bumped by my_scanf_register
+
+static void free_compiled(compiled_format *cf) {
+    for (int i = 0; i < cf->count; i++) free(cf->dirs[i].set);
+    free(cf->dirs);
+    free(cf->text);
+    memset(cf, 0, sizeof(*cf));
+}
+
+// Appends a directive, growing the array as needed. Returns NULL if out of memory.
+static directive *add_directive(compiled_format *cf, int *cap, int kind) {
+    if (cf->count == *cap) {
+        int grown_cap = *cap ? *cap * 2 : 8;
+        directive *grown = realloc(cf->dirs, grown_cap * sizeof(directive));
+        if (!grown) return NULL;
+        cf->dirs = grown;
+        *cap = grown_cap;
+    }
+    directive *d = &cf->dirs[cf->count++];
+    memset(d, 0, sizeof(*d));
+    d->kind = kind;
+    return d;
+}
+
+// Appends one literal byte, extending the previous directive when it is a
+// literal run with room left. Returns 0 if out of memory.
+static int add_literal(compiled_format *cf, int *cap, char c) {
+    directive *d = cf->count ? &cf->dirs[cf->count - 1] : NULL;
+    if (!d || d->kind != DIR_LITERAL || d->literal_len == LITERAL_RUN) {
+        if (!(d = add_directive(cf, cap, DIR_LITERAL))) return 0;
+    }
+    d->literal[d->literal_len++] = c;
+    return 1;
+}
+
+// Parses `format` into cf->dirs. Returns 0 if out of memory.
+static int compile_format(const char *format, compiled_format *cf) {
+    int cap = 0;
+    directive *d;
+
+    for (const char *p = format; *p; p++) {
+        if (*p != '%') {
+            if (IS_SPACE(*p)) {
+                // Any whitespace in format matches any whitespace in input
+                while (IS_SPACE(p[1])) p++;
+                if (!(d = add_directive(cf, &cap, DIR_SPACE))) return 0;
+            } else if (!add_literal(cf, &cap, *p)) {
+                return 0;
+            }
+            continue;
+        }
+
+        p++;                    // Move past '%'
+        my_scanf_spec spec;
+        memset(&spec, 0, sizeof(spec));
+
+        // Check for suppression operator '*'
+        if (*p == '*') { spec.suppress = 1; p++; }
+
+        // CSV flag for %D (%qD), accepted before or after the width
+        if (*p == 'q') { spec.csv = 1; p++; }
+
+        // Handle literal "%%" (matches a single '%' in input)
+        if (*p == '%') {
+            if (!add_literal(cf, &cap, '%')) return 0;
+            continue;
+        }
+
+        // Optional field width parsing (e.g., %10s)
+        while (IS_DIGIT(*p)) {
+            spec.width = spec.width * 10 + (*p - '0');  // Accumulate width
+            p++;
+        }
+        if (*p == 'q') { spec.csv = 1; p++; }
+
+        // Optional length modifiers: h, hh, l, ll, j, z, t, L
+        if (*p == 'h' && *(p+1) == 'h') { strcpy(spec.length,"hh"); p+=2; }
+        else if (*p == 'h') { strcpy(spec.length,"h"); p++; }
+        else if (*p == 'l' && *(p+1) == 'l') { strcpy(spec.length,"ll"); p+=2; }
+        else if (*p == 'l') { strcpy(spec.length,"l"); p++; }
+        else if (*p == 'j' || *p == 'z' || *p == 't' || *p == 'L') { spec.length[0] = *p; p++; }
+
+        spec.spec = *p;         // Conversion specifier character
+        if (!spec.spec) break;  // End of format string
+
+        if (!(d = add_directive(cf, &cap, DIR_CONVERSION))) return 0;
+        d->spec = spec;
+
+        unsigned char c = (unsigned char)spec.spec;
+        if (c < 128 && custom_conversions[c]) {
+            d->fn = custom_conversions[c];
+        } else if (c < 128 && builtin_conversions[c].fn) {
+            d->fn = builtin_conversions[c].fn;
+            d->flags = builtin_conversions[c].flags;
+        } else {
+            d->fn = conv_literal;
+            d->flags = CONV_NO_ARG | CONV_NO_ASSIGN;
+        }
+
+        assign_shape(d);
+
+        if (c == '[') {
+            if (!(d->set = malloc(sizeof(scanset)))) return 0;
+            p = parse_scanset(p + 1, d->set);
+            if (!*p) {          // Unterminated set: the call stops here
+                d->kind = DIR_STOP;
+                break;
+            }
+        }
+    }
+    return 1;
+}
+
+// Returns the compiled form of `format`, from the cache when possible.
+// Sets *temporary when the result is not cached and must be freed by the caller.
+static compiled_format *get_compiled(const char *format, compiled_format *scratch, int *temporary) {
+    compiled_format *cf = &format_cache[((uintptr_t)format >> 3) % FORMAT_CACHE_SIZE];
+    *temporary = 0;
+    if (cf->key == format && cf->generation == format_generation && cf->utf8 == cur->utf8 &&
+        strcmp(cf->text, format) == 0)
+        return cf;
+
+    if (cf->busy) {             // Slot belongs to a call still running: compile off to the side
+        cf = scratch;
+        memset(cf, 0, sizeof(*cf));
+        *temporary = 1;
+    } else {
+        free_compiled(cf);
+        if (!(cf->text = strdup(format))) return NULL;
+        cf->key = format;
+        cf->generation = format_generation;
+        cf->utf8 = cur->utf8;
+    }
+    if (!compile_format(format, cf)) {
+        free_compiled(cf);
+        return NULL;
+    }
+    return cf;
+}
+
+void my_scanf_thread_cleanup(void) {
+    for (int i = 0; i < FORMAT_CACHE_SIZE; i++)
+        if (!format_cache[i].busy) free_compiled(&format_cache[i]);
+    free(arena.buf);
+    arena.buf = NULL;
+    arena.cap = 0;
+}
+
+int my_scanf_register(char spec, my_scanf_handler handler) {
+    if (reserved_spec((unsigned char)spec)) return -1;
+    custom_conversions[(unsigned char)spec] = handler;
+    format_generation++;        // Cached formats resolved the old handler
+    return 0;
+}
+
+// Handlers are only ever called with the active scanner, so the accessors
+// below work on `cur`; ctx is part of the signature for the handler's benefit.
+int my_scanf_getc(my_scanf_ctx *ctx) {
+    (void)ctx;
+    return next_char();
+}
+
+void my_scanf_ungetc(my_scanf_ctx *ctx, int ch) {
+    (void)ctx;
+    unget_char(ch);
+}
+
+void my_scanf_skip_space(my_scanf_ctx *ctx) {
+    (void)ctx;
+    skip_whitespace();
+}
+
+const char *my_scanf_window(my_scanf_ctx *ctx, size_t *len) {
+    (void)ctx;
+    if (!cur->mem) {
+        *len = 0;
+        return NULL;
+    }
+    *len = cur->end - cur->pos;
+    return (const char *)cur->pos;
+}
+
+void my_scanf_advance(my_scanf_ctx *ctx, size_t n) {
+    (void)ctx;
+    if (cur->mem) {
+        size_t left = cur->end - cur->pos;
+        skip_view(n < left ? n : left);
+        return;
+    }
+    while (n-- > 0 && next_char() != EOF) {}
+}
+
+int my_scanf_fail(my_scanf_ctx *ctx, int ch, int reason) {
+    (void)ctx;
+    return fail_with(ch, reason);
+}
+
+/* =========================
+   FORMAT ENGINE
+   ========================= */
+// Matches a literal run. A memory source compares the whole run at once;
+// otherwise (a stream, or a mismatch to locate) bytes are matched one at a
+// time, so a failure is reported at the byte that differs.
+static int match_literal_run(const char *lit, int len) {
+    if (cur->mem && cur->end - cur->pos >= len && memcmp(cur->pos, lit, len) == 0) {
+        cur->field_start = cur->offset;
+        skip_view(len);
+        return 1;
+    }
+    for (int i = 0; i < len; i++) {
+        cur->field_start = cur->offset;
+        int ch = next_char();
+        if (ch == EOF) { set_error(MY_SCANF_ERR_EOF); return 0; }
+        if (ch != lit[i]) { unget_char(ch); set_error(MY_SCANF_ERR_LITERAL); return 0; }
+    }
+    return 1;
+}
+
+// Runs a compiled format against the current input, consuming arguments from `args`,
+// or from the array `dests` when it is non-NULL (the columnar sink).
+// Returns number of successfully assigned input items.
+// Returns 0 if no assignments could be made, EOF if input ended before any assignments.
+static int run_format(compiled_format *cf, va_list *args, void *const *dests) {
+    // Count of successfully assigned conversions
+    int assigned = 0;
+
+    // Fresh error record; position counters carry over between calls
+    cur->call_start = cur->offset;   // Origin for %n
+    cur->conversion = 0;
+    memset(&cur->err, 0, sizeof(cur->err));
+
+    for (directive *d = cf->dirs, *last = cf->dirs + cf->count; d < last; d++) {
+        switch (d->kind) {
+            case DIR_SPACE:
+                skip_whitespace();
+                break;
+            case DIR_LITERAL:               // Literal characters in format
+                if (!match_literal_run(d->literal, d->literal_len)) goto end;
+                break;
+            case DIR_CONVERSION: {
+                void *dest = d->spec.suppress || (d->flags & CONV_NO_ARG) ? NULL :
+                             dests ? *dests++ : va_arg(*args, void *);
+                cur->field_start = cur->offset;
+                if (!(d->shape.kind ? run_shaped(d, dest) : d->fn((my_scanf_ctx *)cur, &d->spec, dest))) goto end;
+                if (dest && !(d->flags & CONV_NO_ASSIGN)) assigned++;
+                cur->conversion++;  // Next conversion directive
+                break;
+            }
+            case DIR_STOP:
+                goto end;
+        }
+    }
+
+end:
+    // EOF only for an input failure: the input ended where a field or literal
+    // was due to start. A completed format, a field that was read whole but
+    // rejected (bad date, bad %B token), or one cut short after some of it
+    // was read ("-", "1e") is not
+    if (assigned) return assigned;
+    if (cur->err.reason != MY_SCANF_ERR_EOF) return 0;
+    return at_eof() && cur->offset == cur->field_start ? EOF : 0;
+}
+
+// Compiles (or fetches) `format` and runs it against the current input.
+static int scan_format(const char *format, va_list args) {
+    compiled_format scratch;
+    int temporary;
+    compiled_format *cf = get_compiled(format, &scratch, &temporary);
+    if (!cf) return 0;
+
+    va_list copy;
+    va_copy(copy, args);
+    cf->busy++;
+    int ret = run_format(cf, &copy, NULL);
+    cf->busy--;
+    va_end(copy);
+    if (temporary) free_compiled(cf);
+    return ret;
+}
+
+/* =========================
+   RECOVERY MODE
+   ========================= */
+// Skips the rest of the current record (through the next '\n') after a failed parse.
+// getline() finds the separator with libc's vectorized memchr over the stdio buffer
+// instead of a getc loop. Recovery is a stdin setting, so the source is always a stream.
+// The rejected row is copied to the sink if one is set.
+// Returns 0 if the input ended while skipping.
+static int resync_record(void) {
+    ssize_t n;
+    int ch = 0;
+
+    // Bytes held in the stream ring come first: a single one goes
+    // back to the FILE for getline, more are consumed here
+    settle_stream();
+    while (stream_held(cur) > 0 && (ch = next_char()) != '\n') {}
+    n = ch == '\n' ? 0 : getline(&cur->skip_buf, &cur->skip_cap, cur->fp);
+    cur->rejected++;
+
+    if (cur->reject_sink) {
+        fwrite(cur->rec, 1, cur->rec_len, cur->reject_sink);
+        if (n > 0) fwrite(cur->skip_buf, 1, (size_t)n, cur->reject_sink);
+        if (n <= 0 || cur->skip_buf[n - 1] != '\n') fputc('\n', cur->reject_sink);
+    }
+    cur->rec_len = 0;
+    cur->rec_restart = 0;
+
+    if (ch == '\n') return 1;      // Row ended inside the stream ring
+    if (n <= 0) return 0;
+    cur->offset += n;
+    cur->line++;        // The skipped span ends at a newline or at the end of input
+    return 1;
+}
+
+// Runs the format until one record parses, dropping malformed records in between.
+// Each attempt restarts the argument list, so a good record overwrites partial
+// assignments left by a rejected one.
+static int scan_records(const char *format, va_list args) {
+    for (;;) {
+        va_list attempt;
+        va_copy(attempt, args);
+        int ret = scan_format(format, attempt);
+        va_end(attempt);
+
+        // Complete record, or the input ran out mid-format
+        if (cur->err.reason == MY_SCANF_OK ||
+            cur->err.reason == MY_SCANF_ERR_OVERFLOW ||
+            cur->err.reason == MY_SCANF_ERR_EOF)
+            return ret;
+
+        if (!resync_record()) return EOF;
+    }
+}
+
+void my_scanf_set_recovery(int enabled, FILE *reject_sink) {
+    stdin_scanner.recover = enabled;
+    stdin_scanner.reject_sink = enabled ? reject_sink : NULL;
+}
+
+long long my_scanf_rejected(void) {
+    return stdin_scanner.rejected;
+}
+
+/* =========================
+   my_scanf
+   ========================= */
+// Custom scanf implementation supporting standard conversions and extensions (%b, %D, %B).
+// Returns number of successfully assigned input items.
+// Returns 0 if no assignments could be made, EOF if input ended before any assignments.
+// In recovery mode malformed records are skipped instead of ending the call.
+int my_scanf(const char *format, ...) {
+    // Variable argument list
+    va_list args;
+    // Initialize it
+    va_start(args, format);
+
+    cur = &stdin_scanner;
+    cur->fp = stdin;
+    int ret = cur->recover ? scan_records(format, args) : scan_format(format, args);
+    settle_stream();
+    last_error = cur->err;
+
+    va_end(args); // Clean up argument list
+    return ret;
+}
+
+/* =========================
+   my_sscanf
+   ========================= */
+// Runs the engine over the bounded view [str, str + len).
+// offset / line give the view's position in a larger input, so error
+// records point into that input rather than into the view.
+static void open_view(scanner_state *view, const char *str, size_t len, long long offset, long long line) {
+    memset(view, 0, sizeof(*view));
+    view->mem = 1;
+    view->pos = (const unsigned char *)str;
+    view->end = view->pos + len;
+    view->offset = offset;
+    view->line = line;
+    view->utf8 = stdin_scanner.utf8;
+}
+
+static int scan_view(const char *str, size_t len, long long offset, long long line,
+                     const char *format, va_list args) {
+    scanner_state view;
+    open_view(&view, str, len, offset, line);
+
+    scanner_state *saved = cur;
+    cur = &view;
+    int ret = scan_format(format, args);
+    last_error = view.err;
+    cur = saved;
+    return ret;
+}
+
+// my_scanf over a string instead of stdin.
+// Returns number of successfully assigned input items, or EOF if the
+// string ended before the first conversion.
+int my_sscanf(const char *str, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int ret = scan_view(str, strlen(str), 0, 0, format, args);
+    va_end(args);
+    return ret;
+}
+
+/* =========================
+   DECOMPRESSION
+   ========================= */
+// The line iterator reads its blocks through a source: the stream as is,
+// gzip / zlib data through zlib (builds with -DMY_SCANF_ZLIB -lz), or the
+// built-in LZ block format below. Every codec decodes straight into the
+// iterator's block buffer, so the scanner sees the decompressed bytes
+// where they were written.
+//
+// LZ stream: the magic "MSLZ", then blocks of
+//   u32 raw size (little endian, 1..LZ_BLOCK; 0 ends the stream)
+//   u32 compressed size
+//   sequences: a token (literal count << 4 | match length - 4), extra
+//   literal count bytes while the nibble and each byte are at their
+//   maximum (15, then 255), the literals, a 2-byte little-endian match
+//   offset and extra match length bytes the same way. The last sequence of
+//   a block has literals only.
+// This is the LZ4 block layout. Blocks are independent: a match never
+// reaches into an earlier block.
+#define LZ_MAGIC "MSLZ"
+#define LZ_BLOCK 65536
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)     // Largest compressed size of n bytes
+#define SOURCE_IN (LZ_BOUND(LZ_BLOCK) + 8)     // Compressed bytes held at once
+
+typedef struct {
+    FILE *fp;
+    int codec;                  // MY_SCANF_RAW, MY_SCANF_GZIP or MY_SCANF_LZ
+    size_t min_room;            // Free space a read needs in its destination
+    unsigned char *in;          // Bytes read from fp and not yet decoded
+    size_t in_pos, in_len;
+    int done;                   // Codec saw the end of its stream
+    int failed;                 // Input is corrupt or truncated
+    long long start;            // File offset of the stream (0 if fp cannot seek)
+    long long data_pos;         // File offset of the first block (past the LZ magic)
+    long long in_at;            // File offset of in[0]
+    long long block_pos;        // File offset of the LZ block read last
+#ifdef MY_SCANF_ZLIB
+    z_stream z;
+    int z_ready;                // inflateInit2 succeeded
+#endif
+} source;
+
+static inline uint32_t load32le(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Makes at least n bytes of input available in s->in. Returns 0 if the
+// stream ends first.
+static int source_need(source *s, size_t n) {
+    if (s->in_len - s->in_pos >= n) return 1;
+    memmove(s->in, s->in + s->in_pos, s->in_len - s->in_pos);
+    s->in_at += s->in_pos;
+    s->in_len -= s->in_pos;
+    s->in_pos = 0;
+    while (s->in_len < n) {
+        size_t got = fread(s->in + s->in_len, 1, SOURCE_IN - s->in_len, s->fp);
+        if (got == 0) return 0;
+        s->in_len += got;
+    }
+    return 1;
+}
+
+// Opens a source on fp. MY_SCANF_DETECT picks the codec from the first
+// bytes (gzip's 1f 8b, "MSLZ", anything else is read as is).
+static int source_open(source *s, FILE *fp, int codec) {
+    memset(s, 0, sizeof(*s));
+    s->fp = fp;
+    s->min_room = 1;
+    s->start = s->data_pos = s->in_at = ftello(fp) < 0 ? 0 : ftello(fp);
+    if (!(s->in = malloc(SOURCE_IN))) return 0;
+
+    int have4 = (codec == MY_SCANF_DETECT || codec == MY_SCANF_LZ) && source_need(s, 4);
+    if (codec == MY_SCANF_DETECT) {
+        if (s->in_len >= 2 && s->in[0] == 0x1f && s->in[1] == 0x8b) codec = MY_SCANF_GZIP;
+        else if (have4 && memcmp(s->in, LZ_MAGIC, 4) == 0) codec = MY_SCANF_LZ;
+        else codec = MY_SCANF_RAW;
+    }
+    s->codec = codec;
+
+    if (codec == MY_SCANF_LZ) {
+        if (!have4 || memcmp(s->in, LZ_MAGIC, 4) != 0) s->failed = 1;
+        s->in_pos = 4;
+        s->data_pos = s->start + 4;
+        s->min_room = LZ_BLOCK;             // Blocks are decoded whole
+    } else if (codec == MY_SCANF_GZIP) {
+#ifdef MY_SCANF_ZLIB
+        // 15 + 32: a gzip or zlib header, found automatically
+        if (inflateInit2(&s->z, 15 + 32) != Z_OK) return 0;
+        s->z_ready = 1;
+#else
+        return 0;                           // Built without zlib
+#endif
+    } else if (codec != MY_SCANF_RAW) {
+        return 0;
+    }
+    return 1;
+}
+
+// Positions the source at file offset pos, which must be where a block
+// starts (LZ) or where the stream starts (gzip), or any offset (raw).
+// Returns 0 if fp cannot seek.
+static int source_seek(source *s, long long pos) {
+    if (fseeko(s->fp, pos, SEEK_SET) != 0) return 0;
+    s->in_at = pos;
+    s->in_pos = s->in_len = 0;
+    s->done = s->failed = 0;
+#ifdef MY_SCANF_ZLIB
+    if (s->z_ready) inflateReset(&s->z);
+#endif
+    return 1;
+}
+
+static void source_close(source *s) {
+#ifdef MY_SCANF_ZLIB
+    if (s->z_ready) inflateEnd(&s->z);
+#endif
+    free(s->in);
+    s->in = NULL;
+}
+
+// Decodes one LZ block of n compressed bytes into exactly raw bytes at dst.
+// Returns 0 if the block is malformed.
+static int lz_decode(const unsigned char *ip, size_t n, unsigned char *dst, size_t raw) {
+    const unsigned char *iend = ip + n;
+    unsigned char *op = dst, *oend = dst + raw;
+    for (;;) {
+        if (ip == iend) return 0;
+        unsigned token = *ip++;
+        size_t lit = token >> 4, len;
+        if (lit == 15) {
+            unsigned b;
+            do {
+                if (ip == iend) return 0;
+                lit += b = *ip++;
+            } while (b == 255);
+        }
+        if ((size_t)(iend - ip) < lit || (size_t)(oend - op) < lit) return 0;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) return op == oend;     // Last sequence: literals only
+
+        if (iend - ip < 2) return 0;
+        size_t off = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (off == 0 || off > (size_t)(op - dst)) return 0;
+        len = token & 15;
+        if (len == 15) {
+            unsigned b;
+            do {
+                if (ip == iend) return 0;
+                len += b = *ip++;
+            } while (b == 255);
+        }
+        len += 4;
+        if ((size_t)(oend - op) < len) return 0;
+        const unsigned char *m = op - off;
+        if (off >= len) {
+            memcpy(op, m, len);
+            op += len;
+        } else {
+            while (len--) *op++ = *m++;        // Overlapping match repeats the last off bytes
+        }
+    }
+}
+
+// Writes an extended length (the part past a full nibble).
+static unsigned char *lz_put_length(unsigned char *op, size_t len) {
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+// Writes one sequence: literals [lit, lit + lit_len), then a match of
+// match_len bytes at distance off (match_len 0: last sequence).
+static unsigned char *lz_put_sequence(unsigned char *op, const unsigned char *lit, size_t lit_len,
+                                      size_t off, size_t match_len) {
+    size_t ml = match_len ? match_len - 4 : 0;
+    *op++ = (unsigned char)((lit_len < 15 ? lit_len : 15) << 4 | (ml < 15 ? ml : 15));
+    if (lit_len >= 15) op = lz_put_length(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (!match_len) return op;
+    *op++ = (unsigned char)off;
+    *op++ = (unsigned char)(off >> 8);
+    if (ml >= 15) op = lz_put_length(op, ml - 15);
+    return op;
+}
+
+// Compresses n (at most LZ_BLOCK) bytes into dst, which holds LZ_BOUND(n).
+// Greedy: each position looks up the last place its next 4 bytes were
+// seen. Returns the compressed size.
+static size_t lz_encode(const unsigned char *src, size_t n, unsigned char *dst) {
+    enum { HASH_BITS = 12 };
+    uint32_t last[1 << HASH_BITS] = {0};       // Position + 1 of the last occurrence
+    unsigned char *op = dst;
+    size_t ip = 0, anchor = 0;
+    while (ip + 4 <= n) {
+        uint32_t h = load32le(src + ip) * 2654435761u >> (32 - HASH_BITS);
+        size_t cand = last[h];
+        last[h] = (uint32_t)ip + 1;
+        if (cand-- && ip - cand <= 65535 && memcmp(src + cand, src + ip, 4) == 0) {
+            size_t len = 4;
+            while (ip + len < n && src[cand + len] == src[ip + len]) len++;
+            op = lz_put_sequence(op, src + anchor, ip - anchor, ip - cand, len);
+            ip += len;
+            anchor = ip;
+        } else {
+            ip++;
+        }
+    }
+    op = lz_put_sequence(op, src + anchor, n - anchor, 0, 0);
+    return (size_t)(op - dst);
+}
+
+int my_scanf_lz_write(FILE *out, const void *data, size_t len) {
+    unsigned char *block = malloc(LZ_BOUND(LZ_BLOCK) + 8);
+    if (!block) return -1;
+    int ok = fwrite(LZ_MAGIC, 1, 4, out) == 4;
+    for (size_t at = 0; ok && at < len; at += LZ_BLOCK) {
+        size_t raw = len - at < LZ_BLOCK ? len - at : LZ_BLOCK;
+        size_t n = lz_encode((const unsigned char *)data + at, raw, block + 8);
+        for (int i = 0; i < 4; i++) {
+            block[i] = (unsigned char)(raw >> 8 * i);
+            block[4 + i] = (unsigned char)(n >> 8 * i);
+        }
+        ok = fwrite(block, 1, n + 8, out) == n + 8;
+    }
+    static const unsigned char end[4];
+    ok = ok && fwrite(end, 1, 4, out) == 4;
+    free(block);
+    return ok ? 0 : -1;
+}
+
+// Decodes the next stretch of input into dst, which has room bytes free
+// (at least s->min_room). Returns the number of bytes written; 0 at the end
+// of the input or when it turns out to be corrupt (s->failed).
+static size_t source_read(source *s, unsigned char *dst, size_t room) {
+    if (s->done || s->failed) return 0;
+
+    if (s->codec == MY_SCANF_RAW) {
+        size_t n = s->in_len - s->in_pos;      // Bytes read while detecting the codec
+        if (n) {
+            if (n > room) n = room;
+            memcpy(dst, s->in + s->in_pos, n);
+            s->in_pos += n;
+            return n;
+        }
+        return fread(dst, 1, room, s->fp);
+    }
+
+    if (s->codec == MY_SCANF_LZ) {
+        if (!source_need(s, 4)) {
+            s->failed = 1;                      // No end marker: truncated
+            return 0;
+        }
+        size_t raw = load32le(s->in + s->in_pos);
+        s->block_pos = s->in_at + (long long)s->in_pos;
+        if (raw == 0) {
+            s->done = 1;
+            return 0;
+        }
+        if (!source_need(s, 8)) {
+            s->failed = 1;
+            return 0;
+        }
+        size_t n = load32le(s->in + s->in_pos + 4);
+        if (raw > LZ_BLOCK || raw > room || n > LZ_BOUND(LZ_BLOCK) || !source_need(s, 8 + n) ||
+            !lz_decode(s->in + s->in_pos + 8, n, dst, raw)) {
+            s->failed = 1;
+            return 0;
+        }
+        s->in_pos += 8 + n;
+        return raw;
+    }
+
+#ifdef MY_SCANF_ZLIB
+    s->z.next_out = dst;
+    s->z.avail_out = (uInt)(room < UINT_MAX ? room : UINT_MAX);
+    size_t want = s->z.avail_out;
+    while (s->z.avail_out == want) {           // Until some output appears
+        if (s->in_pos == s->in_len) {
+            s->in_at += (long long)s->in_len;
+            s->in_pos = 0;
+            s->in_len = fread(s->in, 1, SOURCE_IN, s->fp);
+            if (s->in_len == 0) {
+                s->failed = 1;                  // Input ended inside a member
+                break;
+            }
+        }
+        s->z.next_in = s->in + s->in_pos;
+        s->z.avail_in = (uInt)(s->in_len - s->in_pos);
+        int r = inflate(&s->z, Z_NO_FLUSH);
+        s->in_pos = s->in_len - s->z.avail_in;
+        if (r == Z_STREAM_END) {
+            // Concatenated members (as gzip and pigz write) continue the stream
+            if (!source_need(s, 1)) {
+                s->done = 1;
+                break;
+            }
+            inflateReset(&s->z);
+        } else if (r != Z_OK && r != Z_BUF_ERROR) {
+            s->failed = 1;
+            break;
+        }
+    }
+    return want - s->z.avail_out;
+#else
+    return 0;
+#endif
+}
+
+/* =========================
+   LINE ITERATOR
+   ========================= */
+// Reads a stream in large blocks and hands each line to the engine as a
+// bounded view. Newlines are located once per block: every 64 bytes are
+// compared against '\n' with SIMD and reduced to a 64-bit mask, and lines
+// are then found by popping set bits, so no per-byte newline test remains.
+#define LINES_BLOCK 65536
+
+#ifdef MY_SCANF_THREADS
+// With overlap, a reader thread decodes the next block into a spare buffer
+// while the current one is scanned. Blocks are written LINES_BLOCK bytes
+// into a buffer; the unfinished line of the old buffer is copied into that
+// headroom when the two are swapped, so the block itself never moves.
+typedef struct {
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned char *spare;       // Buffer the thread decodes into
+    size_t spare_cap;           // Its size, headroom included
+    size_t len;                 // Bytes decoded into it
+    long long block_pos;        // Source position of that block (LZ)
+    int ready;                  // spare holds a block for the iterator
+    int stop;
+} lines_ahead;
+#endif
+
+// Where a decoded LZ block came from, so a checkpoint can name the block
+// to seek back to.
+typedef struct {
+    long long offset;           // Decompressed offset of its first byte
+    long long pos;              // File offset of its header
+} lz_block;
+
+struct my_scanf_lines {
+    source src;                 // Stream and codec the blocks come from
+    unsigned char *buf;         // Block data, padded to a multiple of 64 bytes
+    size_t cap, len;            // Capacity / valid bytes in buf
+    size_t line_start;          // Start of the next unread line in buf
+    uint64_t *masks;            // One newline bitmask per 64 bytes of buf
+    size_t masks_cap;
+    size_t word;                // Next mask word to load
+    uint64_t bits;              // Unconsumed newline bits of word - 1
+    int eof;
+    long long base_offset;      // Stream offset of buf[0]
+    long long line_no;          // Lines returned so far
+    const char *line;           // View of the line last returned
+    size_t line_len;
+    long long end;              // Offset lines must start before, -1 for none (chunks)
+    lz_block *blocks;           // LZ blocks overlapping buf, oldest first
+    size_t block_count, block_cap;
+#ifdef MY_SCANF_THREADS
+    lines_ahead *ahead;         // Reader thread, when overlapping
+#endif
+};
+
+// Rebuilds the newline masks for buf[from..len). Called after a refill,
+// when line_start is from and the kept partial line contains no newline.
+static void index_newlines(my_scanf_lines *it, size_t from) {
+    size_t words = (it->len + 63) / 64;
+    memset(it->buf + it->len, 0, words * 64 - it->len);    // Padding never matches
+    for (size_t w = from / 64; w < words; w++)
+        it->masks[w] = byte_mask64(it->buf + 64 * w, '\n');
+    it->word = from / 64 + 1;
+    it->bits = it->masks[from / 64] & (~0ULL << (from % 64));
+}
+
+// Position of the next newline at or after line_start, or -1 if the block has none left.
+static long next_newline(my_scanf_lines *it) {
+    size_t words = (it->len + 63) / 64;
+    while (it->bits == 0) {
+        if (it->word >= words) return -1;
+        it->bits = it->masks[it->word++];
+    }
+    long pos = (long)((it->word - 1) * 64 + __builtin_ctzll(it->bits));
+    it->bits &= it->bits - 1;
+    return pos;
+}
+
+// Grows the mask array to cover a buffer of cap bytes. Returns 0 if out of memory.
+static int reserve_masks(my_scanf_lines *it, size_t cap) {
+    size_t words = cap / 64 + 1;
+    if (words <= it->masks_cap) return 1;
+    uint64_t *masks = realloc(it->masks, words * sizeof(uint64_t));
+    if (!masks) return 0;
+    it->masks = masks;
+    it->masks_cap = words;
+    return 1;
+}
+
+// Notes that the LZ block at source position pos starts at decompressed
+// offset, and forgets the blocks that end before the next unread line.
+static void track_block(my_scanf_lines *it, long long offset, long long pos) {
+    if (it->src.codec != MY_SCANF_LZ) return;
+    long long line = it->base_offset + (long long)it->line_start;
+    size_t drop = 0;
+    while (drop < it->block_count &&
+           (drop + 1 < it->block_count ? it->blocks[drop + 1].offset : offset) <= line) drop++;
+    if (drop) {
+        memmove(it->blocks, it->blocks + drop, (it->block_count - drop) * sizeof(lz_block));
+        it->block_count -= drop;
+    }
+    if (it->block_count == it->block_cap) {
+        size_t cap = it->block_cap ? it->block_cap * 2 : 4;
+        lz_block *grown = realloc(it->blocks, cap * sizeof(lz_block));
+        if (!grown) return;             // The checkpoint then names an earlier block
+        it->blocks = grown;
+        it->block_cap = cap;
+    }
+    it->blocks[it->block_count++] = (lz_block){ offset, pos };
+}
+
+// Moves the unfinished line to the front of the buffer and reads more input.
+// Returns 0 at end of input.
+static int refill_lines(my_scanf_lines *it) {
+    size_t keep = it->len - it->line_start;
+    memmove(it->buf, it->buf + it->line_start, keep);
+    it->base_offset += it->line_start;
+    it->line_start = 0;
+    it->len = keep;
+
+    // A line longer than the block: grow so it fits
+    size_t room = it->src.min_room > LINES_BLOCK / 2 ? it->src.min_room : LINES_BLOCK / 2;
+    if (it->cap - it->len < room) {
+        size_t cap = it->cap;
+        while (cap - it->len < room) cap *= 2;
+        unsigned char *buf = realloc(it->buf, cap + 64);
+        if (buf) it->buf = buf;
+        if (!buf || !reserve_masks(it, cap)) return 0;
+        it->cap = cap;
+    }
+
+    size_t n = source_read(&it->src, it->buf + it->len, it->cap - it->len);
+    if (n == 0) {
+        it->eof = 1;
+        return 0;
+    }
+    track_block(it, it->base_offset + (long long)it->len, it->src.block_pos);
+    it->len += n;
+    index_newlines(it, 0);
+    return 1;
+}
+
+#ifdef MY_SCANF_THREADS
+static void *read_ahead(void *arg) {
+    my_scanf_lines *it = arg;
+    lines_ahead *a = it->ahead;
+    pthread_mutex_lock(&a->lock);
+    for (;;) {
+        while (a->ready && !a->stop) pthread_cond_wait(&a->cond, &a->lock);
+        if (a->stop) break;
+        unsigned char *dst = a->spare + LINES_BLOCK;
+        size_t room = a->spare_cap - LINES_BLOCK;
+        pthread_mutex_unlock(&a->lock);
+        size_t n = source_read(&it->src, dst, room);
+        pthread_mutex_lock(&a->lock);
+        a->len = n;
+        a->block_pos = it->src.block_pos;
+        a->ready = 1;
+        pthread_cond_broadcast(&a->cond);
+        if (n == 0) break;
+    }
+    pthread_mutex_unlock(&a->lock);
+    return NULL;
+}
+
+// refill_lines for an overlapping iterator: takes the block the reader
+// thread decoded, puts the unfinished line in front of it and hands the
+// old buffer back to the thread.
+static int refill_ahead(my_scanf_lines *it) {
+    lines_ahead *a = it->ahead;
+    pthread_mutex_lock(&a->lock);
+    while (!a->ready) pthread_cond_wait(&a->cond, &a->lock);
+    size_t n = a->len;
+    pthread_mutex_unlock(&a->lock);
+    if (n == 0) {
+        it->eof = 1;
+        return 0;
+    }
+
+    unsigned char *next = a->spare;
+    size_t next_cap = a->spare_cap, keep = it->len - it->line_start, start;
+    if (keep <= LINES_BLOCK) {
+        start = LINES_BLOCK - keep;
+    } else {                            // Longer than the headroom: move the block up
+        size_t cap = keep + next_cap - LINES_BLOCK;
+        if (!(next = realloc(next, cap + 64))) return 0;
+        memmove(next + keep, next + LINES_BLOCK, n);
+        a->spare = next;
+        next_cap = cap;
+        start = 0;
+    }
+    if (!reserve_masks(it, next_cap)) return 0;
+    memcpy(next + start, it->buf + it->line_start, keep);
+
+    it->base_offset += (long long)it->line_start - (long long)start;
+    a->spare = it->buf;
+    a->spare_cap = it->cap;
+    it->buf = next;
+    it->cap = next_cap;
+    it->line_start = start;
+    it->len = start + keep + n;
+    index_newlines(it, start);
+    track_block(it, it->base_offset + (long long)(start + keep), a->block_pos);
+
+    pthread_mutex_lock(&a->lock);
+    a->ready = 0;
+    pthread_cond_broadcast(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+    return 1;
+}
+
+// Starts the reader thread. Returns 0 if it could not be started, in
+// which case the iterator reads blocks itself.
+static int start_ahead(my_scanf_lines *it) {
+    lines_ahead *a = calloc(1, sizeof(*a));
+    if (!a) return 0;
+    a->spare_cap = it->cap;
+    if (!(a->spare = malloc(a->spare_cap + 64))) {
+        free(a);
+        return 0;
+    }
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->cond, NULL);
+    it->ahead = a;
+    if (pthread_create(&a->tid, NULL, read_ahead, it) != 0) {
+        pthread_mutex_destroy(&a->lock);
+        pthread_cond_destroy(&a->cond);
+        free(a->spare);
+        free(a);
+        it->ahead = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+static void stop_ahead(lines_ahead *a) {
+    pthread_mutex_lock(&a->lock);
+    a->stop = 1;
+    pthread_cond_broadcast(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+    pthread_join(a->tid, NULL);
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->cond);
+    free(a->spare);
+    free(a);
+}
+#endif
+
+my_scanf_lines *my_scanf_lines_open_codec(FILE *fp, int codec, int overlap) {
+    my_scanf_lines *it = calloc(1, sizeof(*it));
+    if (!it) return NULL;
+    if (!source_open(&it->src, fp, codec)) {
+        my_scanf_lines_close(it);
+        return NULL;
+    }
+    // An overlapping iterator keeps LINES_BLOCK bytes of headroom in front of each block
+    it->end = -1;
+    it->cap = overlap ? 2 * LINES_BLOCK : LINES_BLOCK;
+    it->buf = malloc(it->cap + 64);
+    if (!it->buf || !reserve_masks(it, it->cap)) {
+        my_scanf_lines_close(it);
+        return NULL;
+    }
+#ifdef MY_SCANF_THREADS
+    if (overlap) start_ahead(it);
+#endif
+    return it;
+}
+
+my_scanf_lines *my_scanf_lines_open(FILE *fp) {
+    return my_scanf_lines_open_codec(fp, MY_SCANF_RAW, 0);
+}
+
+// Finds the next line and stores its view in it->line / it->line_len.
+// Returns 0 when no lines remain.
+static int advance_line(my_scanf_lines *it) {
+    if (it->end >= 0 && it->base_offset + (long long)it->line_start >= it->end) return 0;
+    for (;;) {
+        long nl = next_newline(it);
+        if (nl >= 0) {
+            it->line = (const char *)it->buf + it->line_start;
+            it->line_len = (size_t)nl - it->line_start;
+            it->line_start = (size_t)nl + 1;
+            return 1;
+        }
+#ifdef MY_SCANF_THREADS
+        if (!it->eof && it->ahead && refill_ahead(it)) continue;
+        if (!it->eof && !it->ahead && refill_lines(it)) continue;
+#else
+        if (!it->eof && refill_lines(it)) continue;
+#endif
+        if (it->line_start < it->len) {          // Last line without a newline
+            it->line = (const char *)it->buf + it->line_start;
+            it->line_len = it->len - it->line_start;
+            it->line_start = it->len;
+            return 1;
+        }
+        return 0;
+    }
+}
+
+// Error record for the end of the lines: clear, unless the input was cut short.
+static void lines_ended(const my_scanf_lines *it) {
+    memset(&last_error, 0, sizeof(last_error));
+    if (it->src.failed) {                   // Compressed input ended early or is corrupt
+        last_error.offset = it->base_offset + (long long)it->len;
+        last_error.line = it->line_no + 1;
+        last_error.reason = MY_SCANF_ERR_CORRUPT;
+    }
+}
+
+int my_scanf_lines_next(my_scanf_lines *it, const char *format, ...) {
+    if (!advance_line(it)) {
+        lines_ended(it);
+        return EOF;
+    }
+
+    long long offset = it->base_offset + (it->line - (const char *)it->buf);
+    va_list args;
+    va_start(args, format);
+    int ret = scan_view(it->line, it->line_len, offset, it->line_no, format, args);
+    va_end(args);
+    it->line_no++;
+    // A blank line ends before the first conversion, which my_sscanf reports
+    // as EOF; here EOF means no lines remain, so it counts as no match
+    return ret == EOF ? 0 : ret;
+}
+
+const char *my_scanf_lines_current(const my_scanf_lines *it, size_t *len) {
+    if (len) *len = it->line_len;
+    return it->line;
+}
+
+void my_scanf_lines_close(my_scanf_lines *it) {
+    if (!it) return;
+#ifdef MY_SCANF_THREADS
+    if (it->ahead) stop_ahead(it->ahead);
+#endif
+    source_close(&it->src);
+    free(it->buf);
+    free(it->masks);
+    free(it->blocks);
+    free(it);
+}
+/* =========================
+   CHECKPOINTS
+   ========================= */
+// A checkpoint is the position of a scan as plain data: the offset and
+// line count of the next unread record, plus where to seek in the file to
+// get back to it. Nothing else has to be saved: bytes stdin's scanner holds
+// unread are subtracted from the file position, and the iterator's
+// unfinished line is read again after the seek.
+
+int my_scanf_save(my_scanf_checkpoint *cp) {
+    FILE *fp = stdin_scanner.fp ? stdin_scanner.fp : stdin;
+    long long pos = ftello(fp);         // Counts a byte pushed back with ungetc as unread
+    if (pos < 0) return -1;
+    pos -= stream_held(&stdin_scanner);
+    memset(cp, 0, sizeof(*cp));
+    cp->offset = stdin_scanner.offset;
+    cp->line = stdin_scanner.line;
+    cp->end = -1;
+    cp->source_pos = pos;
+    cp->rejected = stdin_scanner.rejected;
+    cp->codec = MY_SCANF_RAW;
+    return 0;
+}
+
+int my_scanf_restore(const my_scanf_checkpoint *cp) {
+    FILE *fp = stdin_scanner.fp ? stdin_scanner.fp : stdin;
+    if (cp->codec != MY_SCANF_RAW || fseeko(fp, cp->source_pos, SEEK_SET) != 0) return -1;
+    stdin_scanner.fp = fp;
+    stdin_scanner.ahead_pos = 0;
+    stdin_scanner.ahead_len = 0;
+    stdin_scanner.offset = cp->offset;
+    stdin_scanner.line = cp->line;
+    stdin_scanner.rejected = cp->rejected;
+    stdin_scanner.rec_len = 0;
+    memset(&stdin_scanner.err, 0, sizeof(stdin_scanner.err));
+    return 0;
+}
+
+int my_scanf_lines_save(const my_scanf_lines *it, my_scanf_checkpoint *cp) {
+    long long line = it->base_offset + (long long)it->line_start;
+    memset(cp, 0, sizeof(*cp));
+    cp->offset = line;
+    cp->line = it->line_no;
+    cp->end = it->end;
+    cp->codec = it->src.codec;
+    if (it->src.codec == MY_SCANF_RAW) {
+        cp->source_pos = it->src.start + line;
+        return 0;
+    }
+    // LZ: the block holding the line. gzip, or LZ before any block: the start
+    cp->source_pos = it->src.data_pos;
+    cp->skip = line;
+    for (size_t i = it->block_count; i-- > 0;) {
+        if (it->blocks[i].offset <= line) {
+            cp->source_pos = it->blocks[i].pos;
+            cp->skip = line - it->blocks[i].offset;
+            break;
+        }
+    }
+    return 0;
+}
+
+int my_scanf_lines_restore(my_scanf_lines *it, const my_scanf_checkpoint *cp) {
+    if (cp->codec != it->src.codec) return -1;
+#ifdef MY_SCANF_THREADS
+    int overlap = it->ahead != NULL;
+    if (overlap) {
+        stop_ahead(it->ahead);
+        it->ahead = NULL;
+    }
+#endif
+    int ok = source_seek(&it->src, cp->source_pos);
+    it->base_offset = cp->offset - cp->skip;
+    it->len = it->line_start = 0;
+    it->word = 0;
+    it->bits = 0;
+    it->eof = 0;
+    it->line_no = cp->line;
+    it->end = cp->end;
+    it->block_count = 0;
+    it->line = NULL;
+    it->line_len = 0;
+
+    // Decode up to the line: nothing for a plain file, part of one block for LZ
+    for (long long skip = cp->skip; ok && skip > 0;) {
+        size_t n = source_read(&it->src, it->buf, it->cap);
+        if (n == 0) {
+            ok = 0;
+        } else if ((long long)n > skip) {
+            it->len = n;
+            it->line_start = (size_t)skip;
+            track_block(it, it->base_offset, it->src.block_pos);
+            index_newlines(it, it->line_start);
+            skip = 0;
+        } else {
+            it->base_offset += (long long)n;
+            skip -= (long long)n;
+        }
+    }
+#ifdef MY_SCANF_THREADS
+    if (overlap) start_ahead(it);
+#endif
+    return ok ? 0 : -1;
+}
+
+int my_scanf_lines_split(FILE *fp, my_scanf_checkpoint *chunks, int n) {
+    long long start = ftello(fp);
+    if (n < 1 || start < 0 || fseeko(fp, 0, SEEK_END) != 0) return -1;
+    long long size = ftello(fp) - start, prev = 0;
+    for (int i = 0; i < n; i++) {
+        long long at = size * i / n;
+        if (i > 0 && at > prev) {
+            // A chunk starts after the newline that ends the line holding byte at - 1
+            int ch;
+            fseeko(fp, start + at - 1, SEEK_SET);
+            while ((ch = getc(fp)) != EOF && ch != '\n') {}
+            at = ch == EOF ? size : ftello(fp) - start;
+        }
+        if (at < prev) at = prev;
+        memset(&chunks[i], 0, sizeof(chunks[i]));
+        chunks[i].offset = at;
+        chunks[i].source_pos = start + at;
+        chunks[i].codec = MY_SCANF_RAW;
+        if (i > 0) chunks[i - 1].end = at;
+        prev = at;
+    }
+    chunks[n - 1].end = size;
+    fseeko(fp, start, SEEK_SET);
+    return 0;
+}
+
+/* =========================
+   COLUMNAR SINK
+   ========================= */
+// A sink owns a compiled format and one column per assigning conversion.
+// Before each record every conversion's dest is pointed at the next free
+// slot of its column, so the handlers store values straight into the
+// column buffers; there is no second pass to copy them out. A row is kept
+// only when every conversion assigned, otherwise the slots are reused by
+// the next record. Strings are written in place into the column's byte
+// buffer and kept by recording where they end.
+
+typedef struct {
+    int type;                       // MY_SCANF_COL_*
+    int width;                      // Bytes per value, 0 for strings
+    unsigned char *data;            // Values, or string bytes
+    size_t used, cap;               // Bytes of data kept / allocated
+    unsigned long long *offsets;    // Strings: rows + 1 end offsets, offsets[0] = 0
+    size_t offsets_cap;
+} sink_column;
+
+struct my_scanf_sink {
+    compiled_format cf;
+    sink_column *cols;
+    int count;                      // Columns
+    void **dests;                   // Destination of each argument the format takes
+    int *arg_col;                   // Column of each argument, -1 for %n
+    int args;
+    long long scratch;              // Where %n stores
+    long long rows, rejected;
+};
+
+// Type and width of the column a built-in conversion stores into; the
+// widths mirror store_signed_integer / store_float. Returns 0 for a
+// registered conversion, whose value size is unknown.
+static int sink_column_type(const directive *d, sink_column *col) {
+    const my_scanf_spec *spec = &d->spec;
+    const char *length = spec->length;
+    if (d->fn == conv_integer) {
+        char c = spec->spec;
+        col->type = (c == 'u' || c == 'o' || c == 'x' || c == 'X') ? MY_SCANF_COL_UINT : MY_SCANF_COL_INT;
+        col->width = strcmp(length, "hh") == 0 ? 1 :
+                     strcmp(length, "h") == 0 ? (int)sizeof(short) :
+                     strcmp(length, "l") == 0 ? (int)sizeof(long) :
+                     strcmp(length, "ll") == 0 ? (int)sizeof(long long) :
+                     strcmp(length, "j") == 0 ? (int)sizeof(intmax_t) :
+                     strcmp(length, "z") == 0 || strcmp(length, "t") == 0 ? (int)sizeof(size_t) :
+                     (int)sizeof(int);
+    } else if (d->fn == conv_pointer) {
+        col->type = MY_SCANF_COL_UINT;
+        col->width = sizeof(void *);
+    } else if (d->fn == conv_float) {
+        col->type = MY_SCANF_COL_FLOAT;
+        col->width = strcmp(length, "L") == 0 ? (int)sizeof(long double) :
+                     strcmp(length, "l") == 0 || strcmp(length, "ll") == 0 ? (int)sizeof(double) :
+                     (int)sizeof(float);
+    } else if (d->fn == conv_char) {
+        col->type = MY_SCANF_COL_CHARS;
+        col->width = spec->width ? spec->width : 1;
+    } else if (d->fn == conv_string || d->fn == conv_delimited || d->fn == conv_scanset) {
+        col->type = MY_SCANF_COL_STRING;
+        col->width = 0;
+    } else if (d->fn == conv_bool) {
+        col->type = MY_SCANF_COL_INT;
+        col->width = sizeof(int);
+    } else if (d->fn == conv_timestamp) {
+        col->type = MY_SCANF_COL_INT;
+        col->width = sizeof(long long);
+    } else if (d->fn == conv_address) {
+        int v6 = strcmp(length, "l") == 0;
+        col->type = v6 ? MY_SCANF_COL_CHARS : MY_SCANF_COL_UINT;
+        col->width = v6 ? 16 : 4;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// Grows buf to hold need bytes. Returns the (possibly moved) buffer, or
+// NULL if out of memory, leaving buf allocated.
+static void *sink_reserve(void *buf, size_t *cap, size_t need) {
+    if (need <= *cap) return buf;
+    size_t grown_cap = *cap ? *cap : 4096;
+    while (grown_cap < need) grown_cap *= 2;
+    void *grown = realloc(buf, grown_cap);
+    if (grown) *cap = grown_cap;
+    return grown;
+}
+
+// Makes room for one more value in col; a string cannot be longer than
+// the record it comes from. Returns 0 if out of memory.
+static int sink_room(sink_column *col, long long rows, size_t len) {
+    void *data = sink_reserve(col->data, &col->cap, col->used + (col->width ? (size_t)col->width : len + 1));
+    if (!data) return 0;
+    col->data = data;
+    if (col->width) return 1;
+    void *offsets = sink_reserve(col->offsets, &col->offsets_cap, (rows + 2) * sizeof(unsigned long long));
+    if (!offsets) return 0;
+    col->offsets = offsets;
+    return 1;
+}
+
+my_scanf_sink *my_scanf_sink_open(const char *format) {
+    my_scanf_sink *sink = calloc(1, sizeof(*sink));
+    if (!sink) return NULL;
+    if (!compile_format(format, &sink->cf)) goto fail;
+
+    int args = 0;
+    for (int i = 0; i < sink->cf.count; i++) {
+        const directive *d = &sink->cf.dirs[i];
+        if (d->kind == DIR_CONVERSION && !d->spec.suppress && !(d->flags & CONV_NO_ARG)) args++;
+    }
+    sink->cols = calloc(args ? args : 1, sizeof(sink_column));
+    sink->dests = calloc(args ? args : 1, sizeof(void *));
+    sink->arg_col = calloc(args ? args : 1, sizeof(int));
+    if (!sink->cols || !sink->dests || !sink->arg_col) goto fail;
+
+    for (int i = 0; i < sink->cf.count; i++) {
+        const directive *d = &sink->cf.dirs[i];
+        if (d->kind != DIR_CONVERSION || d->spec.suppress || (d->flags & CONV_NO_ARG)) continue;
+        if (d->flags & CONV_NO_ASSIGN) {            // %n takes an argument but is not a value
+            sink->arg_col[sink->args++] = -1;
+            continue;
+        }
+        sink_column *col = &sink->cols[sink->count];
+        if (!sink_column_type(d, col)) goto fail;
+        if (!col->width) {
+            if (!sink_room(col, 0, 0)) goto fail;
+            col->offsets[0] = 0;
+        }
+        sink->arg_col[sink->args++] = sink->count++;
+    }
+    return sink;
+
+fail:
+    my_scanf_sink_close(sink);
+    return NULL;
+}
+
+// Scans one record into the sink. Returns the my_sscanf result.
+static int sink_record(my_scanf_sink *sink, const char *rec, size_t len, long long offset, long long line) {
+    for (int i = 0; i < sink->args; i++) {
+        int c = sink->arg_col[i];
+        if (c < 0) {
+            sink->dests[i] = &sink->scratch;
+            continue;
+        }
+        sink_column *col = &sink->cols[c];
+        if (!sink_room(col, sink->rows, len)) {
+            sink->rejected++;
+            return 0;
+        }
+        if (col->type == MY_SCANF_COL_CHARS) memset(col->data + col->used, 0, col->width);  // %c may read fewer bytes
+        sink->dests[i] = col->data + col->used;
+    }
+
+    scanner_state view;
+    open_view(&view, rec, len, offset, line);
+    scanner_state *saved = cur;
+    cur = &view;
+    int ret = run_format(&sink->cf, NULL, sink->dests);
+    last_error = view.err;
+    cur = saved;
+
+    // Keep the row only if the whole format matched, as recovery mode decides
+    if (ret != sink->count ||
+        (view.err.reason != MY_SCANF_OK && view.err.reason != MY_SCANF_ERR_OVERFLOW)) {
+        sink->rejected++;
+        return ret;
+    }
+    for (int c = 0; c < sink->count; c++) {
+        sink_column *col = &sink->cols[c];
+        if (col->width) {
+            col->used += col->width;
+        } else {
+            col->used += strlen((const char *)col->data + col->used);
+            col->offsets[sink->rows + 1] = col->used;
+        }
+    }
+    sink->rows++;
+    return ret;
+}
+
+int my_scanf_sink_scan(my_scanf_sink *sink, const char *rec, size_t len) {
+    return sink_record(sink, rec, len, 0, 0);
+}
+
+long long my_scanf_sink_lines(my_scanf_sink *sink, my_scanf_lines *it) {
+    long long before = sink->rows;
+    while (advance_line(it)) {
+        long long offset = it->base_offset + (it->line - (const char *)it->buf);
+        sink_record(sink, it->line, it->line_len, offset, it->line_no);
+        it->line_no++;
+    }
+    lines_ended(it);
+    return sink->rows - before;
+}
+
+long long my_scanf_sink_rows(const my_scanf_sink *sink) {
+    return sink->rows;
+}
+
+long long my_scanf_sink_rejected(const my_scanf_sink *sink) {
+    return sink->rejected;
+}
+
+void my_scanf_sink_close(my_scanf_sink *sink) {
+    if (!sink) return;
+    if (sink->cols) {
+        for (int c = 0; c < sink->count; c++) {
+            free(sink->cols[c].data);
+            free(sink->cols[c].offsets);
+        }
+    }
+    free(sink->cols);
+    free(sink->dests);
+    free(sink->arg_col);
+    free_compiled(&sink->cf);
+    free(sink);
+}
+
+// Columnar file layout, all in host byte order:
+//   header       magic, byte order mark, column count, row count
+//   entries      one per column: type, width and where its arrays are
+//   arrays       each starting on a COLUMN_ALIGN boundary: a fixed-width
+//                column's rows * width bytes, or a string column's
+//                rows + 1 offsets followed by its bytes
+#define COLUMN_MAGIC "MSCOLS1"
+#define COLUMN_ORDER 0x01020304u
+#define COLUMN_ALIGN 64
+
+typedef struct {
+    char magic[8];
+    uint32_t order;
+    uint32_t columns;
+    uint64_t rows;
+    uint64_t reserved;
+} column_header;
+
+typedef struct {
+    uint32_t type;
+    uint32_t width;
+    uint64_t data;              // File offset of the values / string bytes
+    uint64_t bytes;             // Their size
+    uint64_t offsets;           // Strings: file offset of the rows + 1 offsets
+} column_entry;
+
+static uint64_t column_align(uint64_t pos) {
+    return (pos + COLUMN_ALIGN - 1) & ~(uint64_t)(COLUMN_ALIGN - 1);
+}
+
+// Writes len bytes at file position *pos after zero padding up to at.
+static int column_put(FILE *out, uint64_t *pos, uint64_t at, const void *data, size_t len) {
+    static const char zeros[COLUMN_ALIGN];
+    if (at > *pos && fwrite(zeros, 1, at - *pos, out) != at - *pos) return 0;
+    if (len && fwrite(data, 1, len, out) != len) return 0;
+    *pos = at + len;
+    return 1;
+}
+
+int my_scanf_sink_write(const my_scanf_sink *sink, FILE *out) {
+    column_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, COLUMN_MAGIC, sizeof(h.magic));
+    h.order = COLUMN_ORDER;
+    h.columns = sink->count;
+    h.rows = sink->rows;
+
+    // Lay out the arrays first so the entries can point at them
+    column_entry *entries = calloc(sink->count ? sink->count : 1, sizeof(column_entry));
+    if (!entries) return -1;
+    uint64_t at = sizeof(h) + (uint64_t)sink->count * sizeof(column_entry);
+    for (int c = 0; c < sink->count; c++) {
+        const sink_column *col = &sink->cols[c];
+        column_entry *e = &entries[c];
+        e->type = col->type;
+        e->width = col->width;
+        if (!col->width) {
+            e->offsets = column_align(at);
+            at = e->offsets + (h.rows + 1) * sizeof(uint64_t);
+        }
+        e->data = column_align(at);
+        e->bytes = col->used;
+        at = e->data + e->bytes;
+    }
+
+    uint64_t pos = 0;
+    int ok = column_put(out, &pos, 0, &h, sizeof(h)) &&
+             column_put(out, &pos, pos, entries, sink->count * sizeof(column_entry));
+    for (int c = 0; ok && c < sink->count; c++) {
+        const sink_column *col = &sink->cols[c];
+        if (!col->width)
+            ok = column_put(out, &pos, entries[c].offsets, col->offsets, (h.rows + 1) * sizeof(uint64_t));
+        ok = ok && column_put(out, &pos, entries[c].data, col->data, col->used);
+    }
+    free(entries);
+    return ok && fflush(out) == 0 ? 0 : -1;
+}
+
+/* =========================
+   COLUMNAR FILES
+   ========================= */
+// A columnar file is mapped read-only and its columns are handed out as
+// pointers into the mapping: loading it reads the header and checks that
+// every array lies inside the file, nothing more.
+
+struct my_scanf_columns {
+    void *map;
+    size_t size;
+    long long rows;
+    int count;
+    my_scanf_column *cols;
+};
+
+my_scanf_columns *my_scanf_columns_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(column_header))
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                  // The mapping stays valid
+    if (map == MAP_FAILED) return NULL;
+
+    my_scanf_columns *file = calloc(1, sizeof(*file));
+    if (!file) goto fail;
+    file->map = map;
+    file->size = st.st_size;
+
+    const column_header *h = map;
+    uint64_t size = file->size;
+    if (memcmp(h->magic, COLUMN_MAGIC, sizeof(h->magic)) != 0 || h->order != COLUMN_ORDER ||
+        h->columns > (size - sizeof(*h)) / sizeof(column_entry) || h->rows > size)
+        goto fail;
+    file->rows = h->rows;
+    file->count = h->columns;
+    if (!(file->cols = calloc(file->count ? file->count : 1, sizeof(my_scanf_column)))) goto fail;
+
+    const column_entry *entries = (const column_entry *)(h + 1);
+    const unsigned char *base = map;
+    for (int c = 0; c < file->count; c++) {
+        const column_entry *e = &entries[c];
+        my_scanf_column *col = &file->cols[c];
+        if (e->type > MY_SCANF_COL_STRING || (e->width == 0) != (e->type == MY_SCANF_COL_STRING) ||
+            e->data > size || e->bytes > size - e->data)
+            goto fail;
+        if (e->width) {
+            if (e->data % COLUMN_ALIGN || e->bytes % e->width || e->bytes / e->width != h->rows) goto fail;
+        } else {
+            uint64_t n = h->rows + 1;
+            if (e->offsets % COLUMN_ALIGN || e->offsets > size || n > (size - e->offsets) / sizeof(uint64_t))
+                goto fail;
+            col->offsets = (const unsigned long long *)(base + e->offsets);
+            if (col->offsets[0] != 0 || col->offsets[h->rows] != e->bytes) goto fail;
+        }
+        col->type = e->type;
+        col->width = e->width;
+        col->data = base + e->data;
+    }
+    return file;
+
+fail:
+    if (file) free(file->cols);
+    free(file);
+    munmap(map, st.st_size);
+    return NULL;
+}
+
+long long my_scanf_columns_rows(const my_scanf_columns *file) {
+    return file->rows;
+}
+
+int my_scanf_columns_count(const my_scanf_columns *file) {
+    return file->count;
+}
+
+const my_scanf_column *my_scanf_columns_get(const my_scanf_columns *file, int i) {
+    return i >= 0 && i < file->count ? &file->cols[i] : NULL;
+}
+
+void my_scanf_columns_close(my_scanf_columns *file) {
+    if (!file) return;
+    munmap(file->map, file->size);
+    free(file->cols);
+    free(file);
+}
+
+/* =========================
+   BULK NUMERIC INPUT
+   ========================= */
+// my_scan_int64s / my_scan_doubles read a whole file of numbers without the
+// format engine: a loop of separator skip + number kernel + store, straight
+// over memory. Streams are read in large blocks cut after a separator, so
+// no number straddles two blocks. With threads enabled, each large block is
+// split at separators and the parts are parsed in parallel, then joined in order.
+#define BULK_BLOCK (4u << 20)           // Bytes read from a stream per block (per thread)
+#define BULK_MIN_PER_THREAD (256u << 10) // Smaller parts are not worth a thread
+
+enum { BULK_INT64, BULK_DOUBLE };
+
+static int bulk_threads = 1;
+
+void my_scan_set_threads(int n) {
+#ifdef MY_SCANF_THREADS
+    bulk_threads = n < 1 ? 1 : n;
+#else
+    (void)n;                            // Built without thread support
+#endif
+}
+
+// Parses an optionally signed decimal integer at p. Up to 16 digits are
+// converted eight at a time when at least 16 bytes are readable; longer
+// numbers and the end of the buffer continue digit by digit.
+// Values outside int64 saturate and set *overflow.
+// Returns the end of the number, or NULL if there are no digits.
+static const unsigned char *bulk_int64(const unsigned char *p, const unsigned char *end,
+                                       long long *out, int *overflow) {
+    int negative = *p == '-';           // p < end: the caller stopped on a non-separator
+    p += negative | (*p == '+');
+
+    const unsigned char *digits = p;
+    uint64_t v = 0;
+    int saturated = 0;
+    if (end - p >= 16) {
+        uint64_t x = load64(p);
+        int n = swar_digit_run(x);
+        if (n == 0) return NULL;
+        v = swar_number(x, n);
+        p += n;
+        if (n < 8) goto done;           // The usual case: the whole number was in one word
+        if ((n = swar_digit_run(x = load64(p))) > 0) {
+            v = v * pow10_u64[n] + swar_number(x, n);
+            p += n;
+        }
+    }
+
+    for (; p < end && IS_DIGIT(*p); p++)
+        if (__builtin_mul_overflow(v, 10, &v) || __builtin_add_overflow(v, (uint64_t)(*p - '0'), &v))
+            saturated = 1;
+    if (p == digits) return NULL;
+
+done:;
+
+    uint64_t limit = negative ? (uint64_t)LLONG_MAX + 1 : (uint64_t)LLONG_MAX;
+    if (saturated || v > limit) {
+        v = limit;
+        *overflow = 1;
+    }
+    *out = negative ? (long long)(0 - v) : (long long)v;
+    return p;
+}
+
+// Parses a decimal floating-point number at p, with the same mantissa and
+// scaling rules as scan_float (see decimal_to_double).
+// Returns the end of the number, or NULL if it is malformed.
+static const unsigned char *bulk_double(const unsigned char *p, const unsigned char *end, double *out) {
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    uint64_t mantissa = 0;
+    int significant = 0, exp10 = 0, any = 0;
+    for (; p < end && IS_DIGIT(*p); p++, any = 1)
+        add_decimal_digit(&mantissa, &significant, &exp10, *p - '0', 0);
+    if (p < end && *p == '.')
+        for (p++; p < end && IS_DIGIT(*p); p++, any = 1)
+            add_decimal_digit(&mantissa, &significant, &exp10, *p - '0', 1);
+    if (!any) return NULL;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int exp_negative = 0, exponent = 0;
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) exp_negative = (*p++ == '-');
+        if (p == end || !IS_DIGIT(*p)) return NULL;
+        for (; p < end && IS_DIGIT(*p); p++)
+            if (exponent < 100000) exponent = exponent * 10 + (*p - '0');
+        exp10 += exp_negative ? -exponent : exponent;
+    }
+
+    double value = decimal_to_double(mantissa, exp10);
+    *out = negative ? -value : value;
+    return p;
+}
+
+// Growable output of one parse.
+typedef struct {
+    void *data;                 // long long[] or double[]
+    size_t len, cap;
+} bulk_vec;
+
+static int bulk_grow(bulk_vec *vec) {
+    size_t cap = vec->cap ? vec->cap * 2 : 1024;
+    void *grown = realloc(vec->data, cap * 8);     // Both element types are 8 bytes
+    if (!grown) return 0;
+    vec->data = grown;
+    vec->cap = cap;
+    return 1;
+}
+
+// One contiguous part of the input and what parsing it produced.
+typedef struct {
+    int kind;
+    const unsigned char *begin, *end;
+    const unsigned char *is_sep;        // 256-entry separator table
+    bulk_vec vec;
+    const unsigned char *stop;          // First malformed byte, or NULL
+    int reason;                         // Why parsing stopped early
+    const unsigned char *overflow_at;   // First saturated int64, or NULL
+    size_t overflow_index;              // Its index in vec
+} bulk_part;
+
+// Outcome of bulk_run: positions are byte offsets into the parsed span.
+typedef struct {
+    int reason;                 // MY_SCANF_OK, or why parsing stopped
+    size_t stop;                // Offset of the malformed value
+    size_t overflow_at;         // Offset of the first saturated value, or SIZE_MAX
+    size_t overflow_index;      // Its index in the output
+} bulk_result;
+
+// Parses every number in [begin, end) into part->vec.
+static void *bulk_parse(void *arg) {
+    bulk_part *part = arg;
+    const unsigned char *p = part->begin, *end = part->end, *is_sep = part->is_sep;
+    int kind = part->kind;
+    // Locals for the hot loop; written back to part->vec on the way out
+    unsigned char *data = part->vec.data;
+    size_t len = part->vec.len, cap = part->vec.cap;
+
+    for (;;) {
+        while (p < end && is_sep[*p]) p++;
+        if (p == end) break;
+        if (len == cap) {
+            part->vec.len = len;
+            if (!bulk_grow(&part->vec)) {
+                part->stop = p;
+                part->reason = MY_SCANF_ERR_EOF;
+                break;
+            }
+            data = part->vec.data;
+            cap = part->vec.cap;
+        }
+
+        const unsigned char *next;
+        if (kind == BULK_INT64) {
+            int overflow = 0;
+            long long v = 0;            // Unset when there are no digits
+            next = bulk_int64(p, end, &v, &overflow);
+            memcpy(data + len * 8, &v, 8);
+            if (overflow && !part->overflow_at) {
+                part->overflow_at = p;
+                part->overflow_index = len;
+            }
+        } else {
+            double v = 0;
+            next = bulk_double(p, end, &v);
+            memcpy(data + len * 8, &v, 8);
+        }
+        // A number must end at a separator or the end of the input
+        if (!next || (next < end && !is_sep[*next])) {
+            part->stop = next ? next : p;
+            part->reason = next ? MY_SCANF_ERR_INVALID : MY_SCANF_ERR_NO_DIGITS;
+            break;
+        }
+        len++;
+        p = next;
+    }
+    part->vec.len = len;
+    return NULL;
+}
+
+// Parses [p, end) onto the end of *vec, in parallel parts when threads are
+// enabled and the input is large. Parts are cut at a separator, so each one
+// holds whole numbers. Values after the first malformed one are dropped.
+static bulk_result bulk_run(int kind, const unsigned char *p, const unsigned char *end,
+                            const unsigned char *is_sep, bulk_vec *vec) {
+    bulk_result res = { MY_SCANF_OK, 0, SIZE_MAX, 0 };
+    int parts = bulk_threads;
+    size_t len = end - p;
+    if ((size_t)parts > len / BULK_MIN_PER_THREAD) parts = (int)(len / BULK_MIN_PER_THREAD);
+    if (parts < 1) parts = 1;
+
+    bulk_part part[parts];
+    const unsigned char *begin = p;
+    for (int i = 0; i < parts; i++) {
+        memset(&part[i], 0, sizeof(part[i]));
+        part[i].kind = kind;
+        part[i].is_sep = is_sep;
+        part[i].begin = begin;
+        const unsigned char *cut = (i == parts - 1) ? end : p + len / parts * (i + 1);
+        while (cut < end && !is_sep[*cut]) cut++;
+        part[i].end = begin = cut;
+    }
+    part[0].vec = *vec;                 // The first part appends to the output directly
+
+#ifdef MY_SCANF_THREADS
+    pthread_t tid[parts];
+    int started[parts];
+    for (int i = 1; i < parts; i++) started[i] = pthread_create(&tid[i], NULL, bulk_parse, &part[i]) == 0;
+    bulk_parse(&part[0]);
+    for (int i = 1; i < parts; i++) {
+        if (started[i]) pthread_join(tid[i], NULL);
+        else bulk_parse(&part[i]);
+    }
+#else
+    for (int i = 0; i < parts; i++) bulk_parse(&part[i]);
+#endif
+
+    // Join the parts in order, up to and including the first that failed
+    *vec = part[0].vec;
+    for (int i = 0; i < parts; i++) {
+        size_t base = i > 0 ? vec->len : 0;    // Part 0 already indexes into the output
+        if (i > 0 && res.reason == MY_SCANF_OK) {
+            while (vec->len + part[i].vec.len > vec->cap && res.reason == MY_SCANF_OK)
+                if (!bulk_grow(vec)) {
+                    res.reason = MY_SCANF_ERR_EOF;
+                    res.stop = part[i].begin - p;
+                }
+            if (res.reason == MY_SCANF_OK) {
+                memcpy((char *)vec->data + vec->len * 8, part[i].vec.data, part[i].vec.len * 8);
+                vec->len += part[i].vec.len;
+            }
+        }
+        if (i > 0) free(part[i].vec.data);
+        if (res.reason != MY_SCANF_OK) continue;
+        if (part[i].overflow_at && res.overflow_at == SIZE_MAX) {
+            res.overflow_at = part[i].overflow_at - p;
+            res.overflow_index = base + part[i].overflow_index;
+        }
+        if (part[i].stop) {
+            res.reason = part[i].reason;
+            res.stop = part[i].stop - p;
+        }
+    }
+    return res;
+}
+
+// Newlines in [p, end), for error line numbers.
+static long long count_lines(const unsigned char *p, const unsigned char *end) {
+    long long n = 0;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        n++;
+        p++;
+    }
+    return n;
+}
+
+// Records where a bulk read stopped. pos is the stream offset, line the
+// newlines before it and index the number of values read before it.
+static void bulk_error(int reason, long long pos, long long line, size_t index) {
+    last_error.offset = pos;
+    last_error.line = line + 1;
+    last_error.conversion = index > INT_MAX ? INT_MAX : (int)index;
+    last_error.reason = reason;
+}
+
+// Common driver: from a buffer (fp NULL) or a stream read in blocks.
+static size_t bulk_scan(int kind, FILE *fp, const char *buf, size_t buf_len,
+                        void **out, size_t *cap, int sep) {
+    unsigned char is_sep[256];
+    for (int c = 0; c < 256; c++) is_sep[c] = IS_SPACE(c) || (sep && c == (unsigned char)sep);
+
+    bulk_vec vec = { *out, 0, *out ? *cap : 0 };
+    memset(&last_error, 0, sizeof(last_error));
+
+    if (!fp) {
+        const unsigned char *p = (const unsigned char *)buf;
+        bulk_result res = bulk_run(kind, p, p + buf_len, is_sep, &vec);
+        if (res.reason != MY_SCANF_OK)
+            bulk_error(res.reason, (long long)res.stop, count_lines(p, p + res.stop), vec.len);
+        else if (res.overflow_at != SIZE_MAX)
+            bulk_error(MY_SCANF_ERR_OVERFLOW, (long long)res.overflow_at,
+                       count_lines(p, p + res.overflow_at), res.overflow_index);
+    } else {
+        size_t block = BULK_BLOCK * (size_t)bulk_threads, carry = 0;
+        unsigned char *data = malloc(block);
+        long long offset = 0, lines = 0;
+        int overflow_seen = 0;
+
+        while (data) {
+            size_t n = fread(data + carry, 1, block - carry, fp), len = carry + n;
+            int at_end = n == 0;
+
+            // Parse up to the last separator; the rest may continue in the next block
+            size_t cut = len;
+            if (!at_end) while (cut > 0 && !is_sep[data[cut - 1]]) cut--;
+            if (cut == 0 && !at_end) {  // No separator yet: read more, growing a full block
+                if (len == block) {
+                    unsigned char *grown = realloc(data, block * 2);
+                    if (!grown) break;
+                    data = grown;
+                    block *= 2;
+                }
+                carry = len;
+                continue;
+            }
+
+            bulk_result res = bulk_run(kind, data, data + cut, is_sep, &vec);
+            if (res.reason != MY_SCANF_OK) {
+                bulk_error(res.reason, offset + (long long)res.stop,
+                           lines + count_lines(data, data + res.stop), vec.len);
+                break;
+            }
+            if (res.overflow_at != SIZE_MAX && !overflow_seen) {
+                bulk_error(MY_SCANF_ERR_OVERFLOW, offset + (long long)res.overflow_at,
+                           lines + count_lines(data, data + res.overflow_at), res.overflow_index);
+                overflow_seen = 1;
+            }
+            if (at_end) break;
+
+            lines += count_lines(data, data + cut);
+            offset += (long long)cut;
+            carry = len - cut;
+            memmove(data, data + cut, carry);
+        }
+        free(data);
+    }
+
+    *out = vec.data;
+    *cap = vec.cap;
+    return vec.len;
+}
+
+size_t my_scan_int64s(FILE *src, long long **out, size_t *cap, int sep) {
+    return bulk_scan(BULK_INT64, src, NULL, 0, (void **)out, cap, sep);
+}
+
+size_t my_scan_doubles(FILE *src, double **out, size_t *cap, int sep) {
+    return bulk_scan(BULK_DOUBLE, src, NULL, 0, (void **)out, cap, sep);
+}
+
+size_t my_scan_int64s_mem(const char *buf, size_t len, long long **out, size_t *cap, int sep) {
+    return bulk_scan(BULK_INT64, NULL, buf, len, (void **)out, cap, sep);
+}
+
+size_t my_scan_doubles_mem(const char *buf, size_t len, double **out, size_t *cap, int sep) {
+    return bulk_scan(BULK_DOUBLE, NULL, buf, len, (void **)out, cap, sep);
+}
@@ -1,6 +1,267 @@
 #ifndef MY_SCANF_H
 #define MY_SCANF_H
 
+#include <stdio.h>
+
+// Reason codes describing why a my_scanf call stopped early.
+// Read them back with my_scanf_last_error() after a short count.
+enum my_scanf_reason {
+    MY_SCANF_OK = 0,          // Every directive matched
+    MY_SCANF_ERR_NO_DIGITS,   // Numeric conversion found no digits
+    MY_SCANF_ERR_OVERFLOW,    // Value was saturated (the conversion still assigned)
+    MY_SCANF_ERR_LITERAL,     // Literal character in the format did not match
+    MY_SCANF_ERR_EOF,         // Input ended before the format was complete
+    MY_SCANF_ERR_EXPONENT,    // 'e' / 'E' present without exponent digits
+    MY_SCANF_ERR_INVALID,     // Input not valid for the conversion (e.g. bad %B token)
+    MY_SCANF_ERR_ENCODING,    // Malformed UTF-8 in UTF-8 mode
+    MY_SCANF_ERR_CORRUPT      // Compressed input is malformed or truncated
+};
+
+// Where and why the most recent my_scanf call stopped.
+typedef struct {
+    long long offset;   // Byte offset of the offending character in the stream
+    long long line;     // 1-based line number of the offending character
+    int conversion;     // 0-based index of the conversion that failed
+    int reason;         // One of enum my_scanf_reason
+} my_scanf_error;
+
 int my_scanf(const char *format, ...);
 
+// Same conversions as my_scanf, reading from a string instead of stdin.
+// Safe to call from several threads at once (as are the line iterator and
+// the bulk functions); my_scanf_last_error() reports the calling thread's
+// last call.
+int my_sscanf(const char *str, const char *format, ...);
+
+// Frees the calling thread's cached compiled formats and scratch buffer.
+// Call it before a worker thread that used the scanner exits.
+void my_scanf_thread_cleanup(void);
+
+// Error record of the last my_scanf call (reason MY_SCANF_OK if it completed).
+const my_scanf_error *my_scanf_last_error(void);
+
+// Resets the offset / line counters, e.g. after stdin was reopened or rewound.
+void my_scanf_reset(void);
+
+// Recovery mode: when a record fails to parse, skip to the next '\n', count the
+// row as rejected (copying it to reject_sink if non-NULL) and retry the format on
+// the next record. my_scanf then only returns on a complete record or at EOF.
+// Applies to stdin only; my_sscanf and the line iterator stop as usual.
+void my_scanf_set_recovery(int enabled, FILE *reject_sink);
+
+// Number of rows skipped by recovery mode since the last my_scanf_reset().
+long long my_scanf_rejected(void);
+
+// UTF-8 mode for %s, %D and %[...]: input is validated as UTF-8, multi-byte
+// characters are never split by a width limit, and Unicode whitespace
+// (U+00A0, U+2000..U+200A, U+3000, ...) counts as whitespace.
+void my_scanf_set_utf8(int enabled);
+
+// Line iterator: reads fp in large blocks, locates newlines with SIMD and
+// runs the format over each line as a bounded view (the '\n' is not part
+// of it). my_scanf_lines_next returns the my_sscanf result for the next
+// line, or EOF when no lines remain; a blank or whitespace-only line
+// returns 0. Error records carry the line's offset and line number within
+// the whole stream.
+typedef struct my_scanf_lines my_scanf_lines;
+
+my_scanf_lines *my_scanf_lines_open(FILE *fp);
+int my_scanf_lines_next(my_scanf_lines *it, const char *format, ...);
+const char *my_scanf_lines_current(const my_scanf_lines *it, size_t *len);
+void my_scanf_lines_close(my_scanf_lines *it);
+
+// Compressed input for the line iterator. Blocks are decompressed straight
+// into the iterator's buffer; no zcat process or pipe is needed.
+enum my_scanf_codec {
+    MY_SCANF_DETECT,    // Choose from the first bytes of the stream
+    MY_SCANF_RAW,       // Not compressed
+    MY_SCANF_GZIP,      // gzip or zlib data (builds with -DMY_SCANF_ZLIB -lz)
+    MY_SCANF_LZ         // Built-in LZ block format, written by my_scanf_lz_write
+};
+
+// Like my_scanf_lines_open, reading fp through codec. With overlap nonzero
+// (and a -DMY_SCANF_THREADS build) a reader thread decompresses the next
+// block while the current one is scanned. Returns NULL for a codec this
+// build does not support (gzip without zlib).
+// If the input turns out to be corrupt or truncated, my_scanf_lines_next
+// returns EOF with reason MY_SCANF_ERR_CORRUPT in my_scanf_last_error().
+my_scanf_lines *my_scanf_lines_open_codec(FILE *fp, int codec, int overlap);
+
+// Writes data as one complete LZ stream to out. Returns 0, or -1 on a
+// write error.
+int my_scanf_lz_write(FILE *out, const void *data, size_t len);
+
+// Checkpoints: the position of a scan saved as plain data, so a job that
+// stops part way can resume there instead of starting over. Save one with
+// fwrite and read it back with fread in the new process.
+typedef struct {
+    long long offset;       // Input bytes before the next unread record (decompressed)
+    long long line;         // Lines before it (stdin: consumed; iterator: returned)
+    long long end;          // Offset where the scan stops (chunks), -1 for end of input
+    long long source_pos;   // File offset to seek to
+    long long skip;         // Decompressed bytes from source_pos to the record
+    long long rejected;     // Rows rejected by recovery mode (stdin)
+    int codec;              // enum my_scanf_codec of the source
+} my_scanf_checkpoint;
+
+// stdin between my_scanf calls. Both return 0, or -1 if stdin cannot seek
+// (a pipe).
+int my_scanf_save(my_scanf_checkpoint *cp);
+int my_scanf_restore(const my_scanf_checkpoint *cp);
+
+// The next line my_scanf_lines_next will return. Restoring needs an
+// iterator on the same file and codec. A plain file resumes with one seek.
+// An LZ stream seeks to the block holding the line and decodes that block
+// only. gzip has no random access, so it is decoded again from the start.
+// Returns 0, or -1 if the stream cannot seek or ends before the checkpoint.
+int my_scanf_lines_save(const my_scanf_lines *it, my_scanf_checkpoint *cp);
+int my_scanf_lines_restore(my_scanf_lines *it, const my_scanf_checkpoint *cp);
+
+// Splits the rest of a seekable plain file into n chunks at line boundaries,
+// for parallel workers. chunks[i] is a checkpoint at the chunk's first line,
+// with .end at the start of the next chunk. Each worker restores its chunk
+// into its own iterator on its own FILE and saves its position with
+// my_scanf_lines_save as it goes. After a restart it restores the saved
+// checkpoint instead. A chunk whose checkpoint has offset == end is
+// finished. Line numbers count from the start of the chunk. Returns 0, or
+// -1 if fp cannot seek.
+int my_scanf_lines_split(FILE *fp, my_scanf_checkpoint *chunks, int n);
+
+// Columnar sink: a format compiled once with one column per assigning
+// conversion. Each record's values are stored straight into per-column
+// buffers that only grow, and my_scanf_sink_write flushes them to a
+// columnar file that my_scanf_columns_open maps back without parsing.
+// Suppressed conversions and %n get no column. A record is added as a row
+// only if the whole format matches it; otherwise it is counted as rejected.
+typedef struct my_scanf_sink my_scanf_sink;
+
+// Returns NULL if out of memory or if the format uses a registered
+// conversion (its value size is not known).
+my_scanf_sink *my_scanf_sink_open(const char *format);
+
+// Scans the record [rec, rec + len). Returns the my_sscanf result.
+int my_scanf_sink_scan(my_scanf_sink *sink, const char *rec, size_t len);
+
+// Scans every remaining line of it. Returns the number of rows added;
+// my_scanf_last_error() reports MY_SCANF_ERR_CORRUPT if the input was cut short.
+long long my_scanf_sink_lines(my_scanf_sink *sink, my_scanf_lines *it);
+
+long long my_scanf_sink_rows(const my_scanf_sink *sink);
+long long my_scanf_sink_rejected(const my_scanf_sink *sink);
+
+// Writes the rows so far as a columnar file. Returns 0, or -1 on a write error.
+int my_scanf_sink_write(const my_scanf_sink *sink, FILE *out);
+void my_scanf_sink_close(my_scanf_sink *sink);
+
+enum my_scanf_column_type {
+    MY_SCANF_COL_INT,       // Signed integer of width bytes (%d, %i, %b, %B, %T)
+    MY_SCANF_COL_UINT,      // Unsigned integer of width bytes (%u, %o, %x, %p, %I)
+    MY_SCANF_COL_FLOAT,     // float, double or long double by width (%f, %e, %g, %a)
+    MY_SCANF_COL_CHARS,     // width bytes as stored (%c, %lI)
+    MY_SCANF_COL_STRING     // Variable length (%s, %[...], %D)
+};
+
+// One column of a mapped file. Row i of a fixed-width column is the width
+// bytes at data + i * width; of a string column, the bytes from
+// offsets[i] to offsets[i + 1] of data (not NUL-terminated).
+typedef struct {
+    int type;                           // enum my_scanf_column_type
+    int width;                          // Bytes per value, 0 for strings
+    const void *data;
+    const unsigned long long *offsets;  // Strings: rows + 1 offsets into data
+} my_scanf_column;
+
+// A columnar file mapped read-only. Values are in the byte order and type
+// sizes of the machine that wrote the file (one of the other byte order
+// is refused). Returns NULL if the file cannot be mapped or is not a valid file.
+typedef struct my_scanf_columns my_scanf_columns;
+
+my_scanf_columns *my_scanf_columns_open(const char *path);
+long long my_scanf_columns_rows(const my_scanf_columns *file);
+int my_scanf_columns_count(const my_scanf_columns *file);
+const my_scanf_column *my_scanf_columns_get(const my_scanf_columns *file, int i);  // NULL if out of range
+void my_scanf_columns_close(my_scanf_columns *file);
+
+// A field returned without copying: len bytes at ptr, not NUL-terminated.
+typedef struct {
+    const char *ptr;
+    size_t len;
+} my_scanf_view;
+
+// Splits one CSV record [rec, rec + len) into fields (RFC 4180 quoting).
+// Fields without escapes are zero-copy views into rec; fields containing
+// doubled quotes are unescaped into scratch, which needs len bytes.
+// Returns the number of fields in the record (only max_fields are stored).
+int my_csv_fields(const char *rec, size_t len, my_scanf_view *fields, int max_fields, char *scratch);
+
+// Bulk numeric input: reads every number in src into *out, growing it with
+// realloc as needed (*out may start NULL with *cap 0; both are updated).
+// Numbers are separated by whitespace and/or the byte sep (0 for whitespace
+// only). Returns the number of values stored. Reading stops at the first
+// malformed value; my_scanf_last_error() then gives its offset, line and
+// index (.conversion), and reason MY_SCANF_OK means all of src was read.
+// Out-of-range int64 values saturate (MY_SCANF_ERR_OVERFLOW).
+size_t my_scan_int64s(FILE *src, long long **out, size_t *cap, int sep);
+size_t my_scan_doubles(FILE *src, double **out, size_t *cap, int sep);
+size_t my_scan_int64s_mem(const char *buf, size_t len, long long **out, size_t *cap, int sep);
+size_t my_scan_doubles_mem(const char *buf, size_t len, double **out, size_t *cap, int sep);
+
+// Threads used by the bulk functions on large inputs (default 1). Takes
+// effect only in builds with -DMY_SCANF_THREADS -pthread.
+void my_scan_set_threads(int n);
+
+// Counters of the adaptive fast paths for %d, %u and %f fields, for the
+// calling thread. Directives without a width parse the common shape of
+// their field (plain digits; a short decimal without exponent) with a
+// specialized parser and fall back to the general one when the shape check
+// fails; a directive that keeps missing is demoted for a while.
+typedef struct {
+    unsigned long long fast;        // Fields parsed by a fast path
+    unsigned long long fallback;    // Shape check failed, general path used
+    unsigned long long general;     // Fields parsed by a demoted directive
+    unsigned long long promotions;  // Demoted directives that went back to their fast path
+    unsigned long long demotions;   // Directives switched to the general path
+} my_scanf_stats;
+
+const my_scanf_stats *my_scanf_get_stats(void);
+void my_scanf_reset_stats(void);
+
+// Custom conversions: my_scanf_register('U', parse_uuid) makes "%U" call
+// parse_uuid for its field. The handler reads input through the ctx accessors
+// below and stores the result through dest, which is the next argument, or
+// NULL when the conversion is suppressed with '*'. It returns nonzero on
+// success, or 0 after recording the failure with my_scanf_fail.
+typedef struct my_scanf_ctx my_scanf_ctx;
+
+// The parsed directive a handler is called for.
+typedef struct {
+    char spec;          // Conversion character
+    char length[3];     // Length modifier: "", "hh", "h", "l", "ll", "j", "z", "t" or "L"
+    int width;          // Maximum field width, 0 if none was given
+    int suppress;       // '*' was given (dest is NULL)
+    int csv;            // 'q' flag was given
+} my_scanf_spec;
+
+typedef int (*my_scanf_handler)(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest);
+
+// Binds spec to handler, replacing any built-in conversion of that letter
+// (a NULL handler restores the built-in). Handlers are looked up once when
+// a format is compiled, not per call. Returns -1 for characters that are
+// part of the directive syntax ('%', '*', '[', digits, q and length letters).
+int my_scanf_register(char spec, my_scanf_handler handler);
+
+int my_scanf_getc(my_scanf_ctx *ctx);               // Next byte, or EOF
+void my_scanf_ungetc(my_scanf_ctx *ctx, int ch);    // Push back the byte just read
+void my_scanf_skip_space(my_scanf_ctx *ctx);        // Skip leading whitespace
+
+// Unread input as one contiguous block, for parsers that work on several
+// bytes at once (memory sources only; returns NULL with *len = 0 on stdin).
+// my_scanf_advance consumes n bytes of it.
+const char *my_scanf_window(my_scanf_ctx *ctx, size_t *len);
+void my_scanf_advance(my_scanf_ctx *ctx, size_t n);
+
+// Records a failed conversion at the current position (reason from
+// enum my_scanf_reason; EOF if ch is EOF). Always returns 0.
+int my_scanf_fail(my_scanf_ctx *ctx, int ch, int reason);
+
 #endif
@@ -1,13 +1,23 @@
+#define _GNU_SOURCE             // timegm()
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "my_scanf.h"
 
 /* =========================
    FORWARD DECLARATIONS
    ========================= */
 void test_integers(void);
+void test_saturation(void);
 void test_hex(void);
 void test_binary(void);
 void test_strings(void);
@@ -19,6 +29,25 @@ void test_percent(void);
 void test_multi_fields(void);
 void test_strings_ext(void);
 void test_chars_multiple(void);
+void test_conversions(void);
+void test_scansets(void);
+void test_utf8(void);
+void test_lookahead(void);
+void test_sscanf(void);
+void test_lines(void);
+void test_compressed(void);
+void test_checkpoints(void);
+void test_sink(void);
+void test_csv(void);
+void test_custom(void);
+void test_long_fields(void);
+void test_timestamps(void);
+void test_addresses(void);
+void test_bulk(void);
+void test_errors(void);
+void test_recovery(void);
+void test_table(void);
+void test_fast_paths(void);
 
 /* =========================
    GLOBAL TEST COUNTERS
@@ -36,12 +65,17 @@ void fail(const char *label) { printf("  ✗ FAIL: %s\n", label); tests_run++; }
 /* =========================
    INPUT REDIRECTION
    ========================= */
+// Points stdin at an in-memory stream over `input`, so scanf and my_scanf
+// read the same bytes without a temporary file. Each call replaces (and
+// closes) the previous test's stream.
+static FILE *test_stdin;
+
 void with_input(const char *input, void (*test_fn)(void)) {
-    FILE *tmp = fopen("test_input.txt", "w");
-    if (!tmp) { perror("fopen"); exit(1); }
-    fputs(input, tmp);
-    fclose(tmp);
-    freopen("test_input.txt", "r", stdin);
+    if (test_stdin) fclose(test_stdin);
+    test_stdin = fmemopen((void *)input, strlen(input), "r");
+    if (!test_stdin) { perror("fmemopen"); exit(1); }
+    stdin = test_stdin;
+    my_scanf_reset();
     test_fn();
 }
 
@@ -69,14 +103,14 @@ void test_integers(void) {
     print_section("Testing integers %d");
     const char *inputs[] = {
         "42\n","-17\n","0\n","   123\n","456abc\n","+99\n","-\n",
-        "2147483647\n","-2147483648\n","999999999999999\n","\n","   \n","+0\n","-0\n",
+        "2147483647\n","-2147483648\n","\n","   \n","+0\n","-0\n",
         "00042\n",          // NEW
         "  -0012\n",        // NEW
         "\t77\n"            // NEW
     };
     const char *labels[] = {
         "positive","negative","zero","leading spaces","trailing garbage","explicit plus",
-        "just minus","INT_MAX","INT_MIN","overflow","empty input","only spaces",
+        "just minus","INT_MAX","INT_MIN","empty input","only spaces",
         "plus zero","minus zero",
         "leading zeros",     // NEW
         "negative leading zeros", // NEW
@@ -86,6 +120,50 @@ void test_integers(void) {
         test_int_compare(labels[i],inputs[i]);
 }
 
+/* =========================
+   INTEGER SATURATION
+   ========================= */
+// libc leaves out-of-range values undefined; my_scanf saturates to the
+// destination type's limits, so these are checked against fixed values.
+static const char *sat_format;
+static long long sat_val;
+static int sat_ret;
+
+void run_myscanf_saturate(void) {
+    union { long long ll; int i; unsigned u; short h; signed char hh; unsigned char hhu; } raw = { 0 };
+    sat_ret = my_scanf(sat_format, &raw);
+    if (strcmp(sat_format, "%hhd") == 0) sat_val = raw.hh;
+    else if (strcmp(sat_format, "%hd") == 0) sat_val = raw.h;
+    else if (strcmp(sat_format, "%x") == 0) sat_val = raw.u;
+    else if (strcmp(sat_format, "%hhx") == 0) sat_val = raw.hhu;
+    else if (strcmp(sat_format, "%lld") == 0) sat_val = raw.ll;
+    else sat_val = raw.i;
+}
+
+void test_saturate(const char *label, const char *format, const char *input, long long expected) {
+    sat_format = format;
+    with_input(input, run_myscanf_saturate);
+    if (sat_ret == 1 && sat_val == expected &&
+        my_scanf_last_error()->reason == MY_SCANF_ERR_OVERFLOW) pass(label);
+    else {
+        printf("    input: '%s' format: '%s' got ret=%d val=%lld reason=%d expected %lld\n",
+               input, format, sat_ret, sat_val, my_scanf_last_error()->reason, expected);
+        fail(label);
+    }
+}
+
+void test_saturation(void) {
+    print_section("Testing integer saturation");
+    test_saturate("int overflow", "%d", "999999999999999\n", 2147483647);
+    test_saturate("int underflow", "%d", "-999999999999999\n", -2147483647LL - 1);
+    test_saturate("char overflow", "%hhd", "300\n", 127);
+    test_saturate("short underflow", "%hd", "-40000\n", -32768);
+    test_saturate("long long overflow", "%lld", "99999999999999999999\n", 9223372036854775807LL);
+    test_saturate("hex overflow", "%x", "123456789\n", 0xFFFFFFFFLL);
+    test_saturate("hex char overflow", "%hhx", "1ff\n", 0xFF);
+    test_saturate("binary overflow", "%b", "111111111111111111111111111111111\n", 2147483647);
+}
+
 /* =========================
    HEX TESTS %x
    ========================= */
@@ -464,11 +542,1972 @@ void test_multi_fields(void) {
         test_multi_compare(labels[i], inputs[i]);
 }
 
+/* =========================
+   MORE CONVERSIONS %u %i %o %e %g %a %p %n
+   ========================= */
+// Each format stores one value followed by %n; conv_equal compares the
+// stored value by the type of the first conversion, so one helper covers
+// every type. Long double is compared by value: its padding bytes are not
+// part of the value and may differ between the two stores.
+typedef union { long double ld; void *ptr; unsigned char bytes[sizeof(long double)]; } conv_slot;
+
+static int conv_equal(const char *format, const conv_slot *a, const conv_slot *b) {
+    const char *p = format;
+    while ((p = strchr(p, '%')) != NULL && p[1] == '%') p += 2;
+    if (!p) return memcmp(a, b, sizeof(*a)) == 0;
+    p++;
+    while (*p >= '0' && *p <= '9') p++;
+    char len = 0, twice = 0;
+    if (*p && strchr("hlLjzt", *p)) { len = *p++; if (*p == len) { twice = 1; p++; } }
+    switch (*p) {
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        if (len == 'L') return a->ld == b->ld || (isnan(a->ld) && isnan(b->ld));
+        if (len == 'l') {
+            double x, y;
+            memcpy(&x, a->bytes, sizeof(x));
+            memcpy(&y, b->bytes, sizeof(y));
+            return x == y || (isnan(x) && isnan(y));
+        } else {
+            float x, y;
+            memcpy(&x, a->bytes, sizeof(x));
+            memcpy(&y, b->bytes, sizeof(y));
+            return x == y || (isnan(x) && isnan(y));
+        }
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': {
+        size_t size = sizeof(int);
+        if (len == 'h') size = twice ? sizeof(char) : sizeof(short);
+        else if (len == 'l') size = twice ? sizeof(long long) : sizeof(long);
+        else if (len == 'j') size = sizeof(intmax_t);
+        else if (len == 'z') size = sizeof(size_t);
+        else if (len == 't') size = sizeof(ptrdiff_t);
+        return memcmp(a->bytes, b->bytes, size) == 0;
+    }
+    case 'p':
+        return a->ptr == b->ptr;
+    default:
+        return memcmp(a, b, sizeof(*a)) == 0;
+    }
+}
+static const char *conv_format;
+static conv_slot conv1, conv2;
+static int conv_r1, conv_r2, conv_n1, conv_n2;
+
+void run_scanf_conv(void) { memset(&conv1,0,sizeof(conv1)); conv_n1 = -1; conv_r1 = scanf(conv_format, &conv1, &conv_n1); }
+void run_myscanf_conv(void) { memset(&conv2,0,sizeof(conv2)); conv_n2 = -1; conv_r2 = my_scanf(conv_format, &conv2, &conv_n2); }
+
+void test_conv_compare(const char *label, const char *format, const char *input) {
+    conv_format = format;
+    with_input(input, run_scanf_conv);
+    with_input(input, run_myscanf_conv);
+    if (conv_r1 == conv_r2 && conv_n1 == conv_n2 && conv_equal(conv_format, &conv1, &conv2)) pass(label);
+    else {
+        printf("    input: '%s' format: '%s'\n", input, format);
+        printf("    scanf:   ret=%d n=%d\n", conv_r1, conv_n1);
+        printf("    myscanf: ret=%d n=%d\n", conv_r2, conv_n2);
+        fail(label);
+    }
+}
+
+void test_conversions(void) {
+    print_section("Testing %u %i %o %e %g %a %p %n");
+    test_conv_compare("unsigned", "%u%n", "42\n");
+    test_conv_compare("unsigned negative wraps", "%u%n", "-1\n");
+    test_conv_compare("unsigned max", "%u%n", "4294967295\n");
+    test_conv_compare("long unsigned", "%lu%n", "18446744073709551615\n");
+    test_conv_compare("size_t", "%zu%n", "123456789012\n");
+    test_conv_compare("intmax_t", "%jd%n", "-9000000000\n");
+    test_conv_compare("auto-base hex", "%i%n", "0x1A\n");
+    test_conv_compare("auto-base octal", "%i%n", "017\n");
+    test_conv_compare("auto-base decimal", "%i%n", "-12\n");
+    test_conv_compare("auto-base stops at 8", "%i%n", "08\n");
+    test_conv_compare("octal", "%o%n", "755\n");
+    test_conv_compare("octal negative", "%o%n", "-7\n");
+    test_conv_compare("uppercase X", "%X%n", "BEEF\n");
+    test_conv_compare("exponent float", "%le%n", "1.5e3\n");
+    test_conv_compare("general float", "%lg%n", "-2.25\n");
+    test_conv_compare("float %E", "%lE%n", "4E-2\n");
+    test_conv_compare("hex float", "%la%n", "0x1.8p3\n");
+    test_conv_compare("hex float no exponent", "%la%n", "0x10\n");
+    test_conv_compare("negative hex float", "%la%n", "-0x.8p1\n");
+    test_conv_compare("long double", "%Lf%n", "2.5\n");
+    test_conv_compare("long double rounding", "%Lf%n", "0.1\n");
+    test_conv_compare("long double many digits", "%Lf%n", "3.14159265358979323846264338327950288\n");
+    test_conv_compare("long double exponent", "%Le%n", "-1.1e-4000\n");
+    test_conv_compare("long double hex", "%La%n", "0x1.123456789abcdefp+3\n");
+    test_conv_compare("long double width", "%5Lf%n", "1.2345678\n");
+    test_conv_compare("pointer", "%p%n", "0x7ffdeadbeef\n");
+    test_conv_compare("count after int", "%d%n", "123 abc\n");
+    test_conv_compare("count after whitespace", "%d %n", "123 abc\n");
+    test_conv_compare("count with literal", "x%d%n", "x77\n");
+    test_conv_compare("width-limited float", "%3lf%n", "12345\n");
+    test_conv_compare("width ends in fraction", "%4lf%n", "1.2345\n");
+    test_conv_compare("width counts float sign", "%2lf%n", "-1.5\n");
+    test_conv_compare("width ends in exponent", "%4le%n", "1e105\n");
+    test_conv_compare("width cuts exponent digits", "%3le%n", "1e57\n");
+    test_conv_compare("width-limited hex float", "%5la%n", "0x1.8p3\n");
+    test_conv_compare("width counts int sign", "%3d%n", "-1234\n");
+    test_conv_compare("width holds only sign", "%1d%n", "-5\n");
+    test_conv_compare("width holds only hex prefix", "%2x%n", "0xff\n");
+    test_conv_compare("width-limited auto base", "%4i%n", "0x1f0\n");
+}
+
+/* =========================
+   SCANSET TESTS %[...]
+   ========================= */
+static const char *set_format;
+static char set1[64], set2[64];
+static int set_r1, set_r2;
+
+void run_scanf_set(void) { memset(set1,0,sizeof(set1)); set_r1 = scanf(set_format, set1); }
+void run_myscanf_set(void) { memset(set2,0,sizeof(set2)); set_r2 = my_scanf(set_format, set2); }
+
+void test_set_compare(const char *label, const char *format, const char *input) {
+    set_format = format;
+    with_input(input, run_scanf_set);
+    with_input(input, run_myscanf_set);
+    if (set_r1 == set_r2 && strcmp(set1, set2) == 0) pass(label);
+    else {
+        printf("    input: '%s' format: '%s'\n", input, format);
+        printf("    scanf:   ret=%d '%s'\n", set_r1, set1);
+        printf("    myscanf: ret=%d '%s'\n", set_r2, set2);
+        fail(label);
+    }
+}
+
+void test_scansets(void) {
+    print_section("Testing scansets %[...]");
+    test_set_compare("range", "%[a-z]", "hello123\n");
+    test_set_compare("negated", "%[^,]", "ab c,d\n");
+    test_set_compare("leading bracket", "%[]a]", "]]a]b\n");
+    test_set_compare("rest of line", "%[^\n]", "line one\n");
+    test_set_compare("no match", "%[0-9]", "abc\n");
+    test_set_compare("width", "%3[a-z]", "abcdef\n");
+    test_set_compare("no whitespace skip", "%[a-z]", "  abc\n");
+    test_set_compare("literal dash at end", "%[a-]", "a-a-b\n");
+}
+
+/* =========================
+   UTF-8 MODE
+   ========================= */
+static const char *u8_format;
+static char u8_val[64];
+static int u8_ret;
+
+void run_myscanf_utf8(void) {
+    memset(u8_val, 0, sizeof(u8_val));
+    my_scanf_set_utf8(1);
+    u8_ret = my_scanf(u8_format, u8_val);
+    my_scanf_set_utf8(0);
+}
+
+void test_utf8_case(const char *label, const char *format, const char *input,
+                    int expected_ret, const char *expected) {
+    u8_format = format;
+    with_input(input, run_myscanf_utf8);
+    if (u8_ret == expected_ret && strcmp(u8_val, expected) == 0) pass(label);
+    else {
+        printf("    input: '%s' format: '%s' got ret=%d '%s' expected ret=%d '%s'\n",
+               input, format, u8_ret, u8_val, expected_ret, expected);
+        fail(label);
+    }
+}
+
+// A compiled %[ set depends on the mode, so the same format literal has to
+// be recompiled after my_scanf_set_utf8, in either direction.
+void test_utf8_toggle(void) {
+    static const char format[] = "%[^\xe3\x80\x81]";
+    const char *input = "x\xe3\x81\x81y\xe3\x80\x81z";
+    char bytes1[16] = "", chars[16] = "", bytes2[16] = "";
+    int r1 = my_sscanf(input, format, bytes1);
+    my_scanf_set_utf8(1);
+    int r2 = my_sscanf(input, format, chars);
+    my_scanf_set_utf8(0);
+    int r3 = my_sscanf(input, format, bytes2);
+    if (r1 == 1 && r2 == 1 && r3 == 1 && strcmp(bytes1, "x") == 0 &&
+        strcmp(chars, "x\xe3\x81\x81y") == 0 && strcmp(bytes2, "x") == 0)
+        pass("scanset recompiled after toggling UTF-8 mode");
+    else {
+        printf("    ret %d %d %d: '%s' '%s' '%s'\n", r1, r2, r3, bytes1, chars, bytes2);
+        fail("scanset recompiled after toggling UTF-8 mode");
+    }
+}
+
+void test_utf8(void) {
+    print_section("Testing UTF-8 mode");
+    test_utf8_case("accented word", "%s", "h\xc3\xa9llo w\xc3\xb6rld\n", 1, "h\xc3\xa9llo");
+    test_utf8_case("ideographic space ends %s", "%s", "\xe6\x97\xa5\xe6\x9c\xac\xe3\x80\x80x\n", 1, "\xe6\x97\xa5\xe6\x9c\xac");
+    test_utf8_case("leading no-break space", "%s", "\xc2\xa0" "abc\n", 1, "abc");
+    test_utf8_case("invalid byte", "%s", "\xff\xfe\n", 0, "");
+    test_utf8_case("overlong encoding", "%s", "\xc0\xaf\n", 0, "");
+    test_utf8_case("width keeps code point whole", "%4s", "h\xc3\xa9llo\n", 1, "h\xc3\xa9l");
+    test_utf8_case("width stops before code point", "%5s", "\xe6\x97\xa5\xe6\x9c\xac\n", 1, "\xe6\x97\xa5");
+    test_utf8_case("scanset with multibyte member", "%[^\xe3\x80\x81]", "\xe6\x9d\xb1\xe4\xba\xac\xe3\x80\x81x\n", 1, "\xe6\x9d\xb1\xe4\xba\xac");
+    test_utf8_case("delimited string", "%D", "na\xc3\xafve,x\n", 1, "na\xc3\xafve");
+    test_utf8_case("4-byte code point", "%s", "\xf0\x9f\x98\x80 x\n", 1, "\xf0\x9f\x98\x80");
+    test_utf8_case("ASCII whitespace table", "%s", "\v\f\r word\n", 1, "word");
+    test_utf8_toggle();
+}
+
+/* =========================
+   STREAM LOOKAHEAD
+   ========================= */
+// Prefixes ("0x", "e+", "p-") are decided by looking ahead in the
+// scanner's stream buffer; after the call the FILE must hold the same
+// unread bytes as after libc's scanf.
+static const char *la_format;
+static char la_next1, la_next2;
+
+void run_scanf_leftover(void) {
+    conv_slot v;
+    scanf(la_format, &v);
+    la_next1 = (char)getchar();
+}
+
+void run_myscanf_leftover(void) {
+    conv_slot v;
+    my_scanf(la_format, &v);
+    la_next2 = (char)getchar();
+}
+
+void test_leftover_compare(const char *label, const char *format, const char *input) {
+    la_format = format;
+    with_input(input, run_scanf_leftover);
+    with_input(input, run_myscanf_leftover);
+    if (la_next1 == la_next2) pass(label);
+    else {
+        printf("    input: '%s' format: '%s' next byte scanf '%c' my_scanf '%c'\n", input, format, la_next1, la_next2);
+        fail(label);
+    }
+}
+
+// A rejected UTF-8 sequence leaves several bytes unread in the buffer;
+// the next call and a checkpoint both have to account for them.
+static int held_r1, held_r2, held_r3, held_saved, held_restored;
+static char held_s1[16], held_s2[16];
+
+void run_myscanf_held(void) {
+    int n = 0;
+    my_scanf_checkpoint cp;
+    my_scanf_set_utf8(1);
+    held_r1 = my_scanf("%d", &n);
+    held_saved = my_scanf_save(&cp);
+    held_r2 = my_scanf("%15s", held_s1);
+    held_restored = my_scanf_restore(&cp);
+    held_r3 = my_scanf("%15s", held_s2);
+    my_scanf_set_utf8(0);
+}
+
+void test_lookahead(void) {
+    print_section("Testing stream lookahead");
+    test_leftover_compare("after hex digits", "%x", "1fq\n");
+    test_leftover_compare("zero without hex marker", "%x", "0q1\n");
+    test_leftover_compare("sign without digits", "%i", "-x5\n");
+    test_leftover_compare("exponent sign without digits", "%lf", "1e+x\n");
+    test_leftover_compare("hex float without digits", "%lf", "0xz\n");
+    test_leftover_compare("binary exponent sign without digits", "%la", "0x1p-q\n");
+    test_leftover_compare("decimal then newline", "%d", "12\n");
+
+    with_input("  \xe2\x82\xac" "5 x\n", run_myscanf_held);
+    if (held_r1 == 0 && held_saved == 0 && held_r2 == 1 && held_restored == 0 && held_r3 == 1 &&
+        strcmp(held_s1, "\xe2\x82\xac" "5") == 0 && strcmp(held_s2, held_s1) == 0)
+        pass("bytes held after a rejected sequence");
+    else {
+        printf("    ret %d %d %d saved=%d restored=%d '%s' '%s'\n", held_r1, held_r2, held_r3,
+               held_saved, held_restored, held_s1, held_s2);
+        fail("bytes held after a rejected sequence");
+    }
+}
+
+/* =========================
+   STRING SOURCE my_sscanf
+   ========================= */
+void test_sscanf_compare(const char *label, const char *format, const char *input) {
+    conv_slot v1, v2;
+    int n1 = -1, n2 = -1;
+    memset(&v1, 0, sizeof(v1));
+    memset(&v2, 0, sizeof(v2));
+    int r1 = sscanf(input, format, &v1, &n1);
+    int r2 = my_sscanf(input, format, &v2, &n2);
+    if (r1 == r2 && n1 == n2 && conv_equal(format, &v1, &v2)) pass(label);
+    else {
+        printf("    input: '%s' format: '%s' sscanf ret=%d n=%d my_sscanf ret=%d n=%d\n",
+               input, format, r1, n1, r2, n2);
+        fail(label);
+    }
+}
+
+void test_sscanf(void) {
+    print_section("Testing my_sscanf");
+    test_sscanf_compare("int", "%d%n", "  -42 rest");
+    test_sscanf_compare("hex", "%x%n", "0xff");
+    test_sscanf_compare("double", "%lf%n", "6.25e1");
+    test_sscanf_compare("long double", "%Lf%n", "0.1");
+    test_sscanf_compare("string", "%s%n", "word next");
+    test_sscanf_compare("empty string", "%d%n", "");
+    test_sscanf_compare("literal mismatch", "x%d%n", "y5");
+    test_sscanf_compare("width-limited float", "%3lf%n", "12345");
+    test_sscanf_compare("width past end of input", "%8lf%n", "2.5");
+    test_sscanf_compare("width ends in exponent", "%4le%n", "1e105");
+    test_sscanf_compare("width holds only sign", "%1d%n", "-5");
+    test_sscanf_compare("width-limited octal", "%2o%n", "7777");
+    test_sscanf_compare("literal run", "x=[%d]%n", "x=[12] tail");
+    test_sscanf_compare("literal run mismatch", "x=[%d%n", "x=(12");
+    test_sscanf_compare("literal run cut by end", "abc%d%n", "ab");
+    test_sscanf_compare("literal run with %%", "%%rate%%=%d%n", "%rate%=7");
+    test_sscanf_compare("literal longer than one run", "temperature_reading_celsius:%d%n",
+                        "temperature_reading_celsius:21");
+    test_sscanf_compare("long whitespace span", " %d%n",
+                        "  \t\t\n\n\v\f\r                                          \t 9");
+    test_sscanf_compare("whitespace span ends at 32", "%d%n",
+                        "                               \x1f" "5");
+
+    // A mismatch inside a literal run is reported at the byte that differs
+    int v;
+    my_sscanf("key\n=value:5", " key\n=valve:%d", &v);
+    const my_scanf_error *e = my_scanf_last_error();
+    if (e->reason == MY_SCANF_ERR_LITERAL && e->offset == 8 && e->line == 2) pass("literal run error position");
+    else {
+        printf("    reason=%d offset=%lld line=%lld\n", e->reason, e->offset, e->line);
+        fail("literal run error position");
+    }
+
+    // Fixed-width record: every field is bounded by its width, not by spaces
+    const char *rec = "  123456-0000001.2500beef";
+    int i1, i2, n1 = -1, n2 = -1;
+    double f1, f2;
+    unsigned x1, x2;
+    int r1 = sscanf(rec, "%8d%12lf%4x%n", &i1, &f1, &x1, &n1);
+    int r2 = my_sscanf(rec, "%8d%12lf%4x%n", &i2, &f2, &x2, &n2);
+    if (r1 == r2 && i1 == i2 && f1 == f2 && x1 == x2 && n1 == n2) pass("fixed-width record %8d%12lf%4x");
+    else {
+        printf("    sscanf ret=%d %d %g %x n=%d my_sscanf ret=%d %d %g %x n=%d\n",
+               r1, i1, f1, x1, n1, r2, i2, f2, x2, n2);
+        fail("fixed-width record %8d%12lf%4x");
+    }
+}
+
+/* =========================
+   LINE ITERATOR
+   ========================= */
+void test_lines_basic(void) {
+    const char *input = "1,2\n3,4\nbad\n5,6";
+    FILE *fp = fmemopen((void *)input, strlen(input), "r");
+    my_scanf_lines *it = my_scanf_lines_open(fp);
+    char got[128] = "";
+    int a, b, r, len = 0, bad_line = 0;
+    long long bad_offset = -1;
+    while ((r = my_scanf_lines_next(it, "%d,%d", &a, &b)) != EOF) {
+        if (r == 2) len += snprintf(got + len, sizeof(got) - len, "(%d,%d)", a, b);
+        else {
+            bad_line = (int)my_scanf_last_error()->line;
+            bad_offset = my_scanf_last_error()->offset;
+        }
+    }
+    my_scanf_lines_close(it);
+    fclose(fp);
+    if (strcmp(got, "(1,2)(3,4)(5,6)") == 0 && bad_line == 3 && bad_offset == 8) pass("records and error position");
+    else {
+        printf("    got %s bad line=%d offset=%lld\n", got, bad_line, bad_offset);
+        fail("records and error position");
+    }
+}
+
+// Blank and whitespace-only lines are rows that do not match, not the end of input.
+void test_lines_blank(void) {
+    const char *input = "1 2\n\n3 4\n   \n5 6\n";
+    FILE *fp = fmemopen((void *)input, strlen(input), "r");
+    my_scanf_lines *it = my_scanf_lines_open(fp);
+    int a, b, r, rows = 0, lines = 0, zeros = 0, sum = 0;
+    while ((r = my_scanf_lines_next(it, "%d %d", &a, &b)) != EOF) {
+        lines++;
+        if (r == 2) { rows++; sum += a + b; }
+        zeros += r == 0;
+    }
+    my_scanf_lines_close(it);
+    fclose(fp);
+    if (rows == 3 && lines == 5 && zeros == 2 && sum == 21) pass("blank lines are not end of input");
+    else {
+        printf("    rows=%d lines=%d zeros=%d sum=%d\n", rows, lines, zeros, sum);
+        fail("blank lines are not end of input");
+    }
+}
+
+void test_lines_blocks(void) {
+    // Enough lines to cross several 64 KiB blocks, plus one line longer than a block
+    size_t cap = 4 << 20, n = 0;
+    char *input = malloc(cap);
+    long long expected = 0;
+    for (int i = 0; i < 200000; i++) {
+        n += sprintf(input + n, "%d %d\n", i, i * 2);
+        expected += i + i * 2;
+    }
+    size_t long_start = n;
+    memset(input + n, 'x', 150000);
+    n += 150000;
+    input[n++] = '\n';
+    n += sprintf(input + n, "7 8\n");
+    expected += 15;
+
+    FILE *fp = fmemopen(input, n, "r");
+    my_scanf_lines *it = my_scanf_lines_open(fp);
+    long long sum = 0;
+    long lines = 0;
+    size_t longest = 0;
+    int a, b, r;
+    while ((r = my_scanf_lines_next(it, "%d %d", &a, &b)) != EOF) {
+        size_t len;
+        my_scanf_lines_current(it, &len);
+        if (len > longest) longest = len;
+        if (r == 2) sum += a + b;
+        lines++;
+    }
+    my_scanf_lines_close(it);
+    fclose(fp);
+    free(input);
+    if (sum == expected && lines == 200002 && longest == n - long_start - 5) pass("lines across blocks");
+    else {
+        printf("    sum=%lld expected=%lld lines=%ld longest=%zu\n", sum, expected, lines, longest);
+        fail("lines across blocks");
+    }
+}
+
+void test_lines(void) {
+    print_section("Testing line iterator");
+    test_lines_basic();
+    test_lines_blank();
+    test_lines_blocks();
+}
+
+/* =========================
+   COMPRESSED INPUT
+   ========================= */
+// Input for the codec tests: lines across many blocks, one line longer than
+// a block and one malformed line whose error offset is checked.
+static char *compressed_sample(size_t *len, long long *expected, long long *bad_offset) {
+    size_t n = 0;
+    char *input = malloc(4 << 20);
+    *expected = 0;
+    for (int i = 0; i < 200000; i++) {
+        if (i == 123456) {
+            *bad_offset = (long long)n + 2;
+            n += sprintf(input + n, "1 x\n");
+        }
+        n += sprintf(input + n, "%d %d\n", i, i % 1000 ? i * 2 : 5);
+        *expected += i + (i % 1000 ? i * 2 : 5);
+    }
+    memset(input + n, 'x', 150000);
+    n += 150000;
+    input[n++] = '\n';
+    n += sprintf(input + n, "7 8");             // No final newline
+    *expected += 15;
+    *len = n;
+    return input;
+}
+
+// Reads the whole of data through the codec and checks the line count, the
+// sum of the pairs and the offset reported for the malformed line.
+static void test_codec_case(const char *label, const char *data, size_t len, int codec, int overlap,
+                            long long expected, long long bad_offset) {
+    FILE *fp = fmemopen((void *)data, len, "r");
+    my_scanf_lines *it = my_scanf_lines_open_codec(fp, codec, overlap);
+    long long sum = 0, error_offset = -1;
+    long lines = 0;
+    int a, b, r;
+    while (it && (r = my_scanf_lines_next(it, "%d %d", &a, &b)) != EOF) {
+        if (r == 2) sum += a + b;
+        else if (r == 1) error_offset = my_scanf_last_error()->offset;
+        lines++;
+    }
+    int reason = my_scanf_last_error()->reason;
+    my_scanf_lines_close(it);
+    fclose(fp);
+    if (sum == expected && lines == 200003 && error_offset == bad_offset && reason == MY_SCANF_OK) pass(label);
+    else {
+        printf("    sum=%lld expected=%lld lines=%ld error at %lld (expected %lld) reason=%d\n",
+               sum, expected, lines, error_offset, bad_offset, reason);
+        fail(label);
+    }
+}
+
+#ifdef MY_SCANF_ZLIB
+#include <zlib.h>
+
+// Compresses data as two concatenated gzip members, as pigz and cat a.gz b.gz produce.
+static char *gzip_members(const char *data, size_t len, size_t *out_len) {
+    size_t cap = compressBound(len) + 64, n = 0, half = len / 2;
+    char *out = malloc(cap);
+    for (int m = 0; m < 2; m++) {
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+        deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        z.next_in = (unsigned char *)data + (m ? half : 0);
+        z.avail_in = (uInt)(m ? len - half : half);
+        z.next_out = (unsigned char *)out + n;
+        z.avail_out = (uInt)(cap - n);
+        deflate(&z, Z_FINISH);
+        n = cap - z.avail_out;
+        deflateEnd(&z);
+    }
+    *out_len = n;
+    return out;
+}
+#endif
+
+void test_compressed(void) {
+    print_section("Testing compressed input");
+    size_t len;
+    long long expected, bad_offset = -1;
+    char *input = compressed_sample(&len, &expected, &bad_offset);
+
+    char *lz = NULL;
+    size_t lz_len = 0;
+    FILE *out = open_memstream(&lz, &lz_len);
+    int wrote = my_scanf_lz_write(out, input, len);
+    fclose(out);
+    if (wrote == 0 && lz_len < len) pass("LZ stream written and smaller");
+    else {
+        printf("    wrote=%d %zu -> %zu bytes\n", wrote, len, lz_len);
+        fail("LZ stream written and smaller");
+    }
+
+    test_codec_case("raw through detection", input, len, MY_SCANF_DETECT, 0, expected, bad_offset);
+    test_codec_case("LZ", lz, lz_len, MY_SCANF_LZ, 0, expected, bad_offset);
+    test_codec_case("LZ through detection", lz, lz_len, MY_SCANF_DETECT, 0, expected, bad_offset);
+    test_codec_case("LZ with overlapped decoding", lz, lz_len, MY_SCANF_LZ, 1, expected, bad_offset);
+    test_codec_case("raw with overlapped reading", input, len, MY_SCANF_RAW, 1, expected, bad_offset);
+
+    // Cut inside the last block: lines up to there, then a corrupt-input error
+    FILE *fp = fmemopen(lz, lz_len - 100, "r");
+    my_scanf_lines *it = my_scanf_lines_open_codec(fp, MY_SCANF_LZ, 0);
+    long lines = 0;
+    int a, b;
+    while (my_scanf_lines_next(it, "%d %d", &a, &b) != EOF) lines++;
+    my_scanf_lines_close(it);
+    fclose(fp);
+    if (lines > 190000 && my_scanf_last_error()->reason == MY_SCANF_ERR_CORRUPT) pass("truncated LZ stream");
+    else {
+        printf("    lines=%ld reason=%d\n", lines, my_scanf_last_error()->reason);
+        fail("truncated LZ stream");
+    }
+
+#ifdef MY_SCANF_ZLIB
+    size_t gz_len;
+    char *gz = gzip_members(input, len, &gz_len);
+    test_codec_case("gzip members", gz, gz_len, MY_SCANF_GZIP, 0, expected, bad_offset);
+    test_codec_case("gzip through detection, overlapped", gz, gz_len, MY_SCANF_DETECT, 1, expected, bad_offset);
+    free(gz);
+#endif
+    free(lz);
+    free(input);
+}
+
+/* =========================
+   CHECKPOINTS
+   ========================= */
+// stdin: read two numbers, save, read to the end, restore and read again.
+static long long cp_first[8], cp_again[8];
+static int cp_n_first, cp_n_again, cp_saved, cp_restored;
+static my_scanf_error cp_err_first, cp_err_again;
+
+static int read_rest(long long *out) {
+    int n = 0;
+    while (n < 8 && my_scanf("%lld", &out[n]) == 1) n++;
+    return n;
+}
+
+void run_checkpoint_stdin(void) {
+    long long a, b;
+    my_scanf_checkpoint cp;
+    my_scanf("%lld%lld", &a, &b);
+    cp_saved = my_scanf_save(&cp);
+    cp_n_first = read_rest(cp_first);
+    cp_err_first = *my_scanf_last_error();
+    cp_restored = my_scanf_restore(&cp);
+    cp_n_again = read_rest(cp_again);
+    cp_err_again = *my_scanf_last_error();
+}
+
+void test_checkpoint_stdin(void) {
+    with_input("10 20\n30 40\n50 x\n", run_checkpoint_stdin);
+    if (cp_saved == 0 && cp_restored == 0 && cp_n_first == 3 && cp_n_again == 3 &&
+        memcmp(cp_first, cp_again, sizeof(long long) * 3) == 0 &&
+        cp_err_again.offset == cp_err_first.offset && cp_err_again.line == cp_err_first.line)
+        pass("stdin resumes at its checkpoint");
+    else {
+        printf("    saved=%d restored=%d read %d then %d, error %lld:%lld then %lld:%lld\n", cp_saved, cp_restored,
+               cp_n_first, cp_n_again, cp_err_first.offset, cp_err_first.line, cp_err_again.offset, cp_err_again.line);
+        fail("stdin resumes at its checkpoint");
+    }
+}
+
+// Reads lines until EOF, summing the pairs; *bad gets the offset and line
+// of the first malformed line.
+static long read_pairs(my_scanf_lines *it, long long *sum, long long *bad_offset, long long *bad_line) {
+    long lines = 0;
+    int a, b, r;
+    while ((r = my_scanf_lines_next(it, "%d %d", &a, &b)) != EOF) {
+        if (r == 2) *sum += a + b;
+        else if (r == 1 && *bad_offset < 0) {
+            *bad_offset = my_scanf_last_error()->offset;
+            *bad_line = my_scanf_last_error()->line;
+        }
+        lines++;
+    }
+    return lines;
+}
+
+// Saves a checkpoint after `skip` lines, finishes the input, then resumes
+// from the checkpoint in a new iterator on a new stream (as a restarted
+// process would) and checks that the rest reads the same.
+static void test_checkpoint_lines(const char *label, const char *data, size_t len, int codec, int overlap,
+                                  long long expected, long skip) {
+    FILE *fp = fmemopen((void *)data, len, "r");
+    my_scanf_lines *it = my_scanf_lines_open_codec(fp, codec, overlap);
+    long long sum = 0, rest = 0, again = 0, bad = -1, bad_line = -1, bad_again = -1, bad_line_again = -1;
+    int a, b;
+    for (long i = 0; i < skip; i++)
+        if (my_scanf_lines_next(it, "%d %d", &a, &b) == 2) sum += a + b;
+    my_scanf_checkpoint cp;
+    unsigned char saved[sizeof(cp)];             // Round trip through bytes, as a file would
+    my_scanf_lines_save(it, &cp);
+    memcpy(saved, &cp, sizeof(cp));
+    long lines = read_pairs(it, &rest, &bad, &bad_line);
+    my_scanf_lines_close(it);
+    fclose(fp);
+
+    fp = fmemopen((void *)data, len, "r");
+    it = my_scanf_lines_open_codec(fp, codec, overlap);
+    memcpy(&cp, saved, sizeof(cp));
+    int restored = my_scanf_lines_restore(it, &cp);
+    long lines_again = read_pairs(it, &again, &bad_again, &bad_line_again);
+    my_scanf_lines_close(it);
+    fclose(fp);
+
+    if (restored == 0 && sum + rest == expected && again == rest && lines_again == lines &&
+        bad_again == bad && bad_line_again == bad_line)
+        pass(label);
+    else {
+        printf("    restored=%d sum %lld + %lld (expected %lld), again %lld; lines %ld / %ld; bad %lld:%lld / %lld:%lld\n",
+               restored, sum, rest, expected, again, lines, lines_again, bad, bad_line, bad_again, bad_line_again);
+        fail(label);
+    }
+}
+
+// One chunk worker: reads its chunk, saving a checkpoint every 5000 lines.
+// With stop_after set it stops there, like a worker whose process died.
+typedef struct {
+    const char *data;
+    size_t len;
+    my_scanf_checkpoint cp;     // Chunk to read; the last checkpoint saved
+    long stop_after;
+    long long sum;              // Sum of the pairs up to cp
+    long lines;
+} chunk_worker;
+
+static void *run_chunk(void *arg) {
+    chunk_worker *w = arg;
+    FILE *fp = fmemopen((void *)w->data, w->len, "r");
+    my_scanf_lines *it = my_scanf_lines_open(fp);
+    long long sum = 0;
+    long lines = 0;
+    int a, b, r;
+    if (my_scanf_lines_restore(it, &w->cp) == 0) {
+        while ((r = my_scanf_lines_next(it, "%d %d", &a, &b)) != EOF) {
+            if (r == 2) sum += a + b;
+            if (++lines == 5000 || w->lines + lines == w->stop_after) {
+                my_scanf_lines_save(it, &w->cp);
+                w->sum += sum;
+                w->lines += lines;
+                sum = lines = 0;
+                if (w->lines == w->stop_after) break;
+            }
+        }
+        if (r == EOF) my_scanf_lines_save(it, &w->cp);
+    }
+    w->sum += sum;
+    w->lines += lines;
+    my_scanf_lines_close(it);
+    fclose(fp);
+    my_scanf_thread_cleanup();
+    return NULL;
+}
+
+// Splits the input into chunks read on parallel threads. One worker stops
+// part way through; a second round restarts every unfinished chunk from
+// its checkpoint.
+static void test_checkpoint_chunks(const char *data, size_t len, long long expected) {
+    enum { CHUNKS = 4 };
+    my_scanf_checkpoint chunks[CHUNKS];
+    chunk_worker w[CHUNKS];
+    FILE *fp = fmemopen((void *)data, len, "r");
+    int split = my_scanf_lines_split(fp, chunks, CHUNKS);
+    fclose(fp);
+
+    memset(w, 0, sizeof(w));
+    for (int i = 0; i < CHUNKS; i++) {
+        w[i].data = data;
+        w[i].len = len;
+        w[i].cp = chunks[i];
+    }
+    w[2].stop_after = 12345;
+    long long sum = 0;
+    long lines = 0;
+    int unfinished = 0;
+    for (int round = 0; round < 2; round++) {
+        pthread_t tid[CHUNKS];
+        for (int i = 0; i < CHUNKS; i++) pthread_create(&tid[i], NULL, run_chunk, &w[i]);
+        for (int i = 0; i < CHUNKS; i++) pthread_join(tid[i], NULL);
+        if (round == 0)
+            for (int i = 0; i < CHUNKS; i++) unfinished += w[i].cp.offset != w[i].cp.end;
+        for (int i = 0; i < CHUNKS; i++) w[i].stop_after = 0;
+    }
+    for (int i = 0; i < CHUNKS; i++) {
+        sum += w[i].sum;
+        lines += w[i].lines;
+    }
+    if (split == 0 && unfinished == 1 && sum == expected && lines == 200003) pass("chunk workers resume unfinished chunks");
+    else {
+        printf("    split=%d unfinished=%d sum=%lld expected=%lld lines=%ld\n", split, unfinished, sum, expected, lines);
+        fail("chunk workers resume unfinished chunks");
+    }
+}
+
+void test_checkpoints(void) {
+    print_section("Testing checkpoints");
+    test_checkpoint_stdin();
+
+    size_t len;
+    long long expected, bad_offset = -1;
+    char *input = compressed_sample(&len, &expected, &bad_offset);
+    char *lz = NULL;
+    size_t lz_len = 0;
+    FILE *out = open_memstream(&lz, &lz_len);
+    my_scanf_lz_write(out, input, len);
+    fclose(out);
+
+    test_checkpoint_lines("plain file from the start", input, len, MY_SCANF_RAW, 0, expected, 0);
+    test_checkpoint_lines("plain file mid-stream", input, len, MY_SCANF_RAW, 0, expected, 100000);
+    test_checkpoint_lines("plain file before the long line", input, len, MY_SCANF_RAW, 0, expected, 200001);
+    test_checkpoint_lines("LZ from the start", lz, lz_len, MY_SCANF_LZ, 0, expected, 0);
+    test_checkpoint_lines("LZ mid-block", lz, lz_len, MY_SCANF_LZ, 0, expected, 100000);
+    test_checkpoint_lines("LZ inside the long line", lz, lz_len, MY_SCANF_LZ, 0, expected, 200002);
+    test_checkpoint_lines("LZ overlapped", lz, lz_len, MY_SCANF_LZ, 1, expected, 150000);
+#ifdef MY_SCANF_ZLIB
+    size_t gz_len;
+    char *gz = gzip_members(input, len, &gz_len);
+    test_checkpoint_lines("gzip mid-stream", gz, gz_len, MY_SCANF_GZIP, 0, expected, 100000);
+    free(gz);
+#endif
+    test_checkpoint_chunks(input, len, expected);
+    free(lz);
+    free(input);
+}
+
+/* =========================
+   COLUMNAR SINK
+   ========================= */
+// Writes the sink to a temporary file and maps it back.
+static my_scanf_columns *sink_round_trip(my_scanf_sink *sink, char *path) {
+    strcpy(path, "/tmp/my_scanf_colsXXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) return NULL;
+    FILE *out = fdopen(fd, "wb");
+    int written = my_scanf_sink_write(sink, out);
+    fclose(out);
+    return written == 0 ? my_scanf_columns_open(path) : NULL;
+}
+
+static int column_string_is(const my_scanf_column *col, long long row, const char *expected) {
+    size_t len = col->offsets[row + 1] - col->offsets[row];
+    return len == strlen(expected) && memcmp((const char *)col->data + col->offsets[row], expected, len) == 0;
+}
+
+// Every kind of column, with malformed records in between.
+static void test_sink_types(void) {
+    const char *input = "1 2.5 alpha 7 ab true 10.0.0.1 2024-01-02T00:00:00Z\n"
+                        "2 oops beta 8 cd false 10.0.0.2 2024-01-02T00:00:00Z\n"
+                        "-3 -0.25 gamma 255 ef false 192.168.1.1 1970-01-01T00:00:00\n"
+                        "\n"
+                        "4 1e3 delta 0 gh yes 127.0.0.1 2000-02-29T00:00:00Z trailing\n"
+                        "5 6 epsilon";
+    FILE *fp = fmemopen((void *)input, strlen(input), "r");
+    my_scanf_lines *it = my_scanf_lines_open(fp);
+    my_scanf_sink *sink = my_scanf_sink_open("%lld %lf %s %hhu %2c %B %I %T");
+    long long added = my_scanf_sink_lines(sink, it);
+    if (added == 3 && my_scanf_sink_rows(sink) == 3 && my_scanf_sink_rejected(sink) == 3)
+        pass("sink keeps complete records only");
+    else {
+        printf("    added=%lld rows=%lld rejected=%lld\n", added, my_scanf_sink_rows(sink), my_scanf_sink_rejected(sink));
+        fail("sink keeps complete records only");
+    }
+    my_scanf_lines_close(it);
+    fclose(fp);
+
+    char path[64];
+    my_scanf_columns *file = sink_round_trip(sink, path);
+    my_scanf_sink_close(sink);
+    if (!file) {
+        fail("columnar file maps back");
+        unlink(path);
+        return;
+    }
+    const my_scanf_column *id = my_scanf_columns_get(file, 0), *x = my_scanf_columns_get(file, 1);
+    const my_scanf_column *name = my_scanf_columns_get(file, 2), *small = my_scanf_columns_get(file, 3);
+    const my_scanf_column *code = my_scanf_columns_get(file, 4), *flag = my_scanf_columns_get(file, 5);
+    const my_scanf_column *ip = my_scanf_columns_get(file, 6), *ts = my_scanf_columns_get(file, 7);
+    int shapes = my_scanf_columns_rows(file) == 3 && my_scanf_columns_count(file) == 8 &&
+                 my_scanf_columns_get(file, 8) == NULL &&
+                 id->type == MY_SCANF_COL_INT && id->width == 8 && x->type == MY_SCANF_COL_FLOAT && x->width == 8 &&
+                 name->type == MY_SCANF_COL_STRING && name->width == 0 &&
+                 small->type == MY_SCANF_COL_UINT && small->width == 1 &&
+                 code->type == MY_SCANF_COL_CHARS && code->width == 2 &&
+                 flag->type == MY_SCANF_COL_INT && flag->width == (int)sizeof(int) &&
+                 ip->type == MY_SCANF_COL_UINT && ip->width == 4 && ts->type == MY_SCANF_COL_INT && ts->width == 8;
+    if (shapes) pass("column types and widths");
+    else fail("column types and widths");
+
+    const long long *ids = id->data, *stamps = ts->data;
+    const double *xs = x->data;
+    const unsigned char *smalls = small->data;
+    const int *flags = flag->data;
+    const unsigned *ips = ip->data;
+    int values = shapes && ids[0] == 1 && ids[1] == -3 && ids[2] == 4 &&
+                 xs[0] == 2.5 && xs[1] == -0.25 && xs[2] == 1000.0 &&
+                 column_string_is(name, 0, "alpha") && column_string_is(name, 1, "gamma") &&
+                 column_string_is(name, 2, "delta") &&
+                 smalls[0] == 7 && smalls[1] == 255 && smalls[2] == 0 &&
+                 memcmp(code->data, "abefgh", 6) == 0 &&
+                 flags[0] == 1 && flags[1] == 0 && flags[2] == 1 &&
+                 ips[0] == 0x0A000001u && ips[1] == 0xC0A80101u && ips[2] == 0x7F000001u &&
+                 stamps[0] == 1704153600000000000LL && stamps[1] == 0 && stamps[2] == 951782400000000000LL;
+    if (values) pass("column values map back without parsing");
+    else fail("column values map back without parsing");
+    my_scanf_columns_close(file);
+    unlink(path);
+}
+
+// Many rows through growing buffers; %n and suppressed fields get no column.
+static void test_sink_growth(void) {
+    my_scanf_sink *sink = my_scanf_sink_open("%*s %d,%f%n %[^\n]");
+    char rec[64];
+    long long id_sum = 0;
+    for (int i = 0; i < 100000; i++) {
+        int len = snprintf(rec, sizeof(rec), "row%d %d,%d.5 name %d", i, i, i % 100, i);
+        my_scanf_sink_scan(sink, rec, (size_t)len);
+        id_sum += i;
+    }
+    char path[64];
+    my_scanf_columns *file = sink_round_trip(sink, path);
+    my_scanf_sink_close(sink);
+    int ok = file && my_scanf_columns_rows(file) == 100000 && my_scanf_columns_count(file) == 3;
+    if (ok) {
+        const int *ids = my_scanf_columns_get(file, 0)->data;
+        const float *xs = my_scanf_columns_get(file, 1)->data;
+        const my_scanf_column *names = my_scanf_columns_get(file, 2);
+        long long sum = 0;
+        for (long long i = 0; i < 100000; i++) sum += ids[i];
+        ok = sum == id_sum && my_scanf_columns_get(file, 1)->width == (int)sizeof(float) &&
+             xs[12345] == 45.5f && column_string_is(names, 0, "name 0") &&
+             column_string_is(names, 99999, "name 99999");
+    }
+    if (ok) pass("100000 rows, %n and %*s without columns");
+    else fail("100000 rows, %n and %*s without columns");
+    my_scanf_columns_close(file);
+    unlink(path);
+}
+
+// Damaged files are refused rather than mapped.
+static void test_sink_bad_files(void) {
+    my_scanf_sink *sink = my_scanf_sink_open("%d %s");
+    my_scanf_sink_scan(sink, "1 one", 5);
+    my_scanf_sink_scan(sink, "2 two", 5);
+    char path[64];
+    my_scanf_columns *file = sink_round_trip(sink, path);
+    my_scanf_sink_close(sink);
+    int good = file != NULL;
+    my_scanf_columns_close(file);
+
+    struct stat st;
+    stat(path, &st);
+    truncate(path, st.st_size - 1);                 // String bytes cut short
+    int truncated = my_scanf_columns_open(path) == NULL;
+    FILE *fp = fopen(path, "r+b");
+    fputc('X', fp);                                 // Bad magic
+    fclose(fp);
+    int bad_magic = my_scanf_columns_open(path) == NULL;
+    unlink(path);
+    int missing = my_scanf_columns_open(path) == NULL;
+    if (good && truncated && bad_magic && missing) pass("damaged columnar files are refused");
+    else {
+        printf("    good=%d truncated=%d bad_magic=%d missing=%d\n", good, truncated, bad_magic, missing);
+        fail("damaged columnar files are refused");
+    }
+}
+
+void test_sink(void) {
+    print_section("Testing the columnar sink");
+    test_sink_types();
+    test_sink_growth();
+    test_sink_bad_files();
+}
+
+/* =========================
+   CSV FIELDS %qD
+   ========================= */
+static char csv_a[128], csv_b[128], csv_c[128];
+static int csv_ret;
+static const char *csv_input;
+
+void run_myscanf_csv(void) {
+    csv_a[0] = csv_b[0] = csv_c[0] = '\0';
+    csv_ret = my_scanf("%qD%qD%qD", csv_a, csv_b, csv_c);
+}
+
+// Checks %qD through both the stream path (stdin) and the SIMD path (my_sscanf).
+void test_csv_case(const char *label, const char *input, int expected_ret,
+                   const char *a, const char *b, const char *c) {
+    int ok = 1;
+    csv_input = input;
+    with_input(input, run_myscanf_csv);
+    ok &= csv_ret == expected_ret && !strcmp(csv_a, a) && !strcmp(csv_b, b) && !strcmp(csv_c, c);
+    if (!ok) printf("    stdin:  ret=%d [%s] [%s] [%s]\n", csv_ret, csv_a, csv_b, csv_c);
+
+    csv_a[0] = csv_b[0] = csv_c[0] = '\0';
+    int r = my_sscanf(input, "%qD%qD%qD", csv_a, csv_b, csv_c);
+    int ok2 = r == expected_ret && !strcmp(csv_a, a) && !strcmp(csv_b, b) && !strcmp(csv_c, c);
+    if (!ok2) printf("    sscanf: ret=%d [%s] [%s] [%s]\n", r, csv_a, csv_b, csv_c);
+
+    if (ok && ok2) pass(label);
+    else fail(label);
+}
+
+void test_csv_fields(void) {
+    // Long quoted field so the quote state carries across 64-byte blocks
+    char rec[512];
+    char long_field[200];
+    memset(long_field, 'x', sizeof(long_field));
+    for (int i = 10; i < 190; i += 20) long_field[i] = ',';
+    long_field[sizeof(long_field) - 1] = '\0';
+    snprintf(rec, sizeof(rec), "plain,\"%s\",\"say \"\"hi\"\"\",\"quoted\"\r", long_field);
+
+    my_scanf_view f[8];
+    char scratch[512];
+    int n = my_csv_fields(rec, strlen(rec), f, 8, scratch);
+    int ok = n == 4 &&
+             f[0].ptr == rec && f[0].len == 5 &&
+             f[1].ptr == rec + 7 && f[1].len == strlen(long_field) &&
+             f[2].len == 8 && !memcmp(f[2].ptr, "say \"hi\"", 8) &&
+             f[3].len == 6 && !memcmp(f[3].ptr, "quoted", 6) && f[3].ptr > rec;
+    if (ok) pass("field views");
+    else { printf("    n=%d\n", n); fail("field views"); }
+}
+
+void test_csv(void) {
+    print_section("Testing CSV fields %qD");
+    test_csv_case("plain fields", "a,b,c\n", 3, "a", "b", "c");
+    test_csv_case("quoted comma", "\"a, b\",c,d\n", 3, "a, b", "c", "d");
+    test_csv_case("doubled quotes", "\"say \"\"hi\"\"\",x,y\n", 3, "say \"hi\"", "x", "y");
+    test_csv_case("quoted newline", "\"line1\nline2\",x,y\n", 3, "line1\nline2", "x", "y");
+    test_csv_case("empty middle field", "a,,c\n", 3, "a", "", "c");
+    test_csv_case("empty last field", "a,b,\n", 3, "a", "b", "");
+    test_csv_case("empty quoted field", "\"\",b,c\n", 3, "", "b", "c");
+    test_csv_case("spaces kept", " a , b ,c\n", 3, " a ", " b ", "c");
+    test_csv_case("crlf record end", "a,b,c\r\n", 3, "a", "b", "c");
+    test_csv_case("record ends early", "a,b\nc\n", 2, "a", "b", "");
+    test_csv_case("empty input", "", -1, "", "", "");
+    test_csv_fields();
+}
+
+/* =========================
+   LONG AND SUPPRESSED FIELDS
+   ========================= */
+static char long_input[20000];
+static char long_buf[8000];
+static int long_n, long_ret;
+
+void run_myscanf_skip_s(void) { long_n = 0; long_ret = my_scanf("%*s %d", &long_n); }
+void run_myscanf_skip_c(void) { long_n = 0; long_ret = my_scanf("%*20c%d", &long_n); }
+void run_myscanf_skip_D(void) { long_n = 0; long_ret = my_scanf("%*D%d", &long_n); }
+void run_myscanf_long_s(void) { long_ret = my_scanf("%s", long_buf); }
+
+// Builds "<n bytes of c><tail>" in long_input.
+static const char *long_field(int n, char c, const char *tail) {
+    memset(long_input, c, n);
+    strcpy(long_input + n, tail);
+    return long_input;
+}
+
+void test_long_fields(void) {
+    print_section("Testing long and suppressed fields");
+
+    with_input(long_field(5000, 'x', " 7\n"), run_myscanf_skip_s);
+    if (long_ret == 1 && long_n == 7) pass("%*s longer than 256");
+    else fail("%*s longer than 256");
+
+    with_input("abcdefghijklmnopqrst42\n", run_myscanf_skip_c);
+    if (long_ret == 1 && long_n == 42) pass("%*20c");
+    else fail("%*20c");
+
+    with_input(long_field(3000, 'y', ",9\n"), run_myscanf_skip_D);
+    if (long_ret == 1 && long_n == 9) pass("%*D longer than 256");
+    else fail("%*D longer than 256");
+
+    with_input(long_field(7000, 'z', "\n"), run_myscanf_long_s);
+    if (long_ret == 1 && strlen(long_buf) == 7000) pass("%s without width longer than 256");
+    else fail("%s without width longer than 256");
+
+    int n = 0;
+    int r = my_sscanf(long_field(4000, 'a', "b5"), "%*[a]b%d", &n);
+    if (r == 1 && n == 5) pass("%*[...] longer than 256");
+    else fail("%*[...] longer than 256");
+
+    r = my_sscanf(long_field(4000, 'q', ",\"x\",3"), "%*qD%*qD%d", &n);
+    if (r == 1 && n == 3) pass("%*qD longer than 256");
+    else fail("%*qD longer than 256");
+
+    // An over-long %B token is rejected whole, not split into two tokens
+    int b = -1;
+    r = my_sscanf(long_field(600, 't', " true"), "%B %B", &b, &b);
+    const my_scanf_error *e = my_scanf_last_error();
+    if (r == 0 && e->reason == MY_SCANF_ERR_INVALID && e->offset == 0) pass("long %B token");
+    else fail("long %B token");
+
+    r = my_sscanf("falsehood yes", "%B", &b);
+    if (r == 0) pass("%B prefix is not a match");
+    else fail("%B prefix is not a match");
+}
+
+/* =========================
+   CUSTOM CONVERSIONS
+   ========================= */
+// %U: a UUID (8-4-4-4-12 hex digits) into 16 bytes, as a domain parser would be written.
+static int parse_uuid(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    unsigned char bytes[16];
+    int n = 0;
+    (void)spec;
+    my_scanf_skip_space(ctx);
+    for (int i = 0; i < 36; i++) {
+        int ch = my_scanf_getc(ctx);
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (ch != '-') { my_scanf_ungetc(ctx, ch); return my_scanf_fail(ctx, ch, MY_SCANF_ERR_INVALID); }
+            continue;
+        }
+        int v = (ch >= '0' && ch <= '9') ? ch - '0' :
+                (ch >= 'a' && ch <= 'f') ? ch - 'a' + 10 :
+                (ch >= 'A' && ch <= 'F') ? ch - 'A' + 10 : -1;
+        if (v < 0) { my_scanf_ungetc(ctx, ch); return my_scanf_fail(ctx, ch, MY_SCANF_ERR_INVALID); }
+        if (n % 2 == 0) bytes[n / 2] = (unsigned char)(v << 4);
+        else bytes[n / 2] |= (unsigned char)v;
+        n++;
+    }
+    if (dest) memcpy(dest, bytes, 16);
+    return 1;
+}
+
+// %W: the width of the directive and the length of the window, to check what handlers see.
+static int report_window(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    size_t len;
+    const char *w = my_scanf_window(ctx, &len);
+    if (!w || len < 2) return my_scanf_fail(ctx, EOF, MY_SCANF_ERR_EOF);
+    my_scanf_advance(ctx, 2);
+    if (dest) *(int *)dest = spec->width * 100 + (int)len;
+    return 1;
+}
+
+// Replacement for %B that only accepts 'Y' / 'N'.
+static int parse_yn(my_scanf_ctx *ctx, const my_scanf_spec *spec, void *dest) {
+    (void)spec;
+    int ch = my_scanf_getc(ctx);
+    if (ch != 'Y' && ch != 'N') { my_scanf_ungetc(ctx, ch); return my_scanf_fail(ctx, ch, MY_SCANF_ERR_INVALID); }
+    if (dest) *(int *)dest = ch == 'Y';
+    return 1;
+}
+
+static const unsigned char uuid_bytes[16] = {
+    0x12, 0x3e, 0x45, 0x67, 0xe8, 0x9b, 0x12, 0xd3, 0xa4, 0x56, 0x42, 0x66, 0x14, 0x17, 0x40, 0x00
+};
+static unsigned char uuid_out[16];
+static int uuid_n, uuid_ret;
+
+void run_myscanf_uuid(void) {
+    memset(uuid_out, 0, sizeof(uuid_out));
+    uuid_ret = my_scanf("%U %d", uuid_out, &uuid_n);
+}
+
+void test_custom(void) {
+    print_section("Testing custom conversions");
+
+    if (my_scanf_register('U', parse_uuid) == 0 && my_scanf_register('W', report_window) == 0) pass("register");
+    else fail("register");
+
+    if (my_scanf_register('%', parse_uuid) == -1 && my_scanf_register('l', parse_uuid) == -1 &&
+        my_scanf_register('7', parse_uuid) == -1 && my_scanf_register('*', parse_uuid) == -1 &&
+        my_scanf_register((char)0xC3, parse_uuid) == -1)
+        pass("reserved characters refused");
+    else fail("reserved characters refused");
+
+    with_input("  123e4567-E89B-12d3-a456-426614174000 42\n", run_myscanf_uuid);
+    if (uuid_ret == 2 && !memcmp(uuid_out, uuid_bytes, 16) && uuid_n == 42) pass("stdin");
+    else fail("stdin");
+
+    unsigned char u[16];
+    int n = 0;
+    int r = my_sscanf("x=123e4567-e89b-12d3-a456-426614174000;7", "x=%U;%d", u, &n);
+    if (r == 2 && !memcmp(u, uuid_bytes, 16) && n == 7) pass("my_sscanf");
+    else fail("my_sscanf");
+
+    n = 0;
+    r = my_sscanf("123e4567-e89b-12d3-a456-426614174000 9", "%*U %d", &n);
+    if (r == 1 && n == 9) pass("suppressed");
+    else fail("suppressed");
+
+    r = my_sscanf("5 123e4567-e89b-12d3-a4X6-426614174000", "%d %U", &n, u);
+    const my_scanf_error *e = my_scanf_last_error();
+    if (r == 1 && e->reason == MY_SCANF_ERR_INVALID && e->conversion == 1 && e->offset == 23) pass("failure record");
+    else { printf("    ret=%d reason=%d conv=%d off=%lld\n", r, e->reason, e->conversion, e->offset); fail("failure record"); }
+
+    int w = 0;
+    r = my_sscanf("abcdef", "a%5W%c", &w, u);
+    if (r == 2 && w == 505 && u[0] == 'd') pass("spec and window");
+    else fail("spec and window");
+
+    // Overriding a built-in, then restoring it; cached formats must follow
+    int b = -1;
+    my_scanf_register('B', parse_yn);
+    r = my_sscanf("Y", "%B", &b);
+    int overridden = r == 1 && b == 1;
+    my_scanf_register('B', NULL);
+    r = my_sscanf("true", "%B", &b);
+    if (overridden && r == 1 && b == 1) pass("override and restore built-in");
+    else fail("override and restore built-in");
+
+    // A registered conversion has no known value size for a column
+    my_scanf_sink *sink = my_scanf_sink_open("%d %U");
+    if (sink == NULL) pass("sink refuses custom conversions");
+    else fail("sink refuses custom conversions");
+    my_scanf_sink_close(sink);
+
+    my_scanf_register('U', NULL);
+    my_scanf_register('W', NULL);
+}
+
+/* =========================
+   TIMESTAMPS %T
+   ========================= */
+static long long ts_value;
+static int ts_ret;
+
+void run_myscanf_ts(void) { ts_value = 0; ts_ret = my_scanf("%T", &ts_value); }
+
+// Reference: timegm() on the same fields, shifted by the zone offset.
+static long long ts_reference(int y, int mo, int d, int h, int mi, int s, long frac_ns, int zone_min) {
+    struct tm tm = {0};
+    tm.tm_year = y - 1900; tm.tm_mon = mo - 1; tm.tm_mday = d;
+    tm.tm_hour = h; tm.tm_min = mi; tm.tm_sec = s;
+    return ((long long)timegm(&tm) - zone_min * 60LL) * 1000000000LL + frac_ns;
+}
+
+void test_timestamp_reference(void) {
+    // Random instants from 1678 to 2261 (the int64 nanosecond range), with
+    // random fractions and zones, read from a string and from stdin
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    int bad = 0;
+    for (int i = 0; i < 2000 && bad < 3; i++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        int y = 1678 + (int)(state % 584), mo = 1 + (int)((state >> 12) % 12);
+        int d = 1 + (int)((state >> 20) % 28), h = (int)((state >> 28) % 24);
+        int mi = (int)((state >> 36) % 60), sec = (int)((state >> 44) % 60);
+        long frac = (long)(state >> 20) % 1000000000L;
+        int zone = (int)((state >> 50) % 1681) - 840;       // -14:00 .. +14:00
+
+        char text[64];
+        int len = snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02d", y, mo, d, h, mi, sec);
+        if (i % 3) len += snprintf(text + len, sizeof(text) - len, ".%09ld", frac);
+        else frac = 0;
+        if (i % 4 == 0) snprintf(text + len, sizeof(text) - len, "Z");
+        else if (i % 4 == 1) zone = 0;
+        else snprintf(text + len, sizeof(text) - len, "%c%02d:%02d", zone < 0 ? '-' : '+', abs(zone) / 60, abs(zone) % 60);
+        if (i % 4 == 0) zone = 0;
+
+        long long expected = ts_reference(y, mo, d, h, mi, sec, frac, zone), got = 0;
+        if (my_sscanf(text, "%T", &got) != 1 || got != expected) {
+            printf("    %s: got %lld expected %lld\n", text, got, expected);
+            bad++;
+        }
+        if (i % 100 == 0) {
+            with_input(text, run_myscanf_ts);
+            if (ts_ret != 1 || ts_value != expected) { printf("    stdin %s\n", text); bad++; }
+        }
+    }
+    if (!bad) pass("matches timegm");
+    else fail("matches timegm");
+}
+
+void test_timestamp_case(const char *label, const char *input, int expected_ret, long long expected) {
+    long long got = 0;
+    int r = my_sscanf(input, "%T", &got);
+    if (r == expected_ret && (r != 1 || got == expected)) pass(label);
+    else { printf("    ret=%d value=%lld\n", r, got); fail(label); }
+}
+
+void test_timestamps(void) {
+    print_section("Testing timestamps %T");
+    test_timestamp_reference();
+    test_timestamp_case("epoch", "1970-01-01T00:00:00Z", 1, 0);
+    test_timestamp_case("space separator", "1970-01-01 00:00:01", 1, 1000000000LL);
+    test_timestamp_case("short fraction", "1970-01-01T00:00:00.5", 1, 500000000LL);
+    test_timestamp_case("fraction truncated", "1970-01-01T00:00:00.1234567899", 1, 123456789LL);
+    test_timestamp_case("before epoch", "1969-12-31T23:59:59.25Z", 1, -750000000LL);
+    test_timestamp_case("compact offset", "1970-01-01T05:30:00+0530", 1, 0);
+    test_timestamp_case("hour offset", "1970-01-01T00:00:00-01", 1, 3600000000000LL);
+    test_timestamp_case("leap day", "2024-02-29T00:00:00Z", 1, 1709164800000000000LL);
+    test_timestamp_case("no leap day", "2023-02-29T00:00:00Z", 0, 0);
+    test_timestamp_case("month 13", "2023-13-01T00:00:00Z", 0, 0);
+    test_timestamp_case("hour 24", "2023-01-01T24:00:00Z", 0, 0);
+    test_timestamp_case("bad separator", "2023/01/01T00:00:00Z", 0, 0);
+    test_timestamp_case("truncated", "2023-01-01T00:00", 0, 0);
+    test_timestamp_case("dot without digits", "2023-01-01T00:00:00.Z", 0, 0);
+    test_timestamp_case("saturates", "2300-01-01T00:00:00Z", 1, LLONG_MAX);
+
+    long long t1 = 0, t2 = 0;
+    char name[16];
+    int r = my_sscanf("2024-05-06T07:08:09Z,bob,2024-05-06T07:08:10.5+00:00",
+                      "%T,%15[^,],%T", &t1, name, &t2);
+    if (r == 3 && t2 - t1 == 1500000000LL && !strcmp(name, "bob")) pass("in a record");
+    else fail("in a record");
+
+    r = my_sscanf("x 2024-05-06T07:61:09Z", "x %T", &t1);
+    const my_scanf_error *e = my_scanf_last_error();
+    if (r == 0 && e->reason == MY_SCANF_ERR_INVALID && e->offset == 2) pass("range error at field start");
+    else fail("range error at field start");
+}
+
+/* =========================
+   ADDRESSES %I
+   ========================= */
+static const char *ipv4_cases[] = {
+    "0.0.0.0", "1.2.3.4", "255.255.255.255", "192.168.001.1", "256.1.1.1", "1.2.3",
+    "1.2.3.4.5", "1..2.3", ".1.2.3", "1.2.3.", "10.0.0.10", "1234.1.1.1", "01.2.3.4",
+    "127.0.0.1", "100.200.250.199",
+};
+
+static const char *ipv6_cases[] = {
+    "::", "::1", "1::", "fe80::1", "2001:db8::8a2e:370:7334", "2001:0db8:0000:0000:0000:ff00:0042:8329",
+    "1:2:3:4:5:6:7:8", "1:2:3:4:5:6:7:8:9", "1:2:3:4:5:6:7::", "1::2::3", ":1:2", "1:2:",
+    "::ffff:192.168.1.1", "::192.168.1.1", "1:2:3:4:5:6:1.2.3.4", "1:2:3:4:5:6:7:1.2.3.4",
+    "12345::1", "ABCD:EF01::", "::ffff:1.2.3", "1:::2", "1:2:3:4:5:6:7:8::",
+};
+
+static unsigned int ip_value;
+static int ip_ret;
+
+void run_myscanf_ip(void) { ip_value = 0; ip_ret = my_scanf("%I;", &ip_value); }
+
+void test_addresses(void) {
+    print_section("Testing addresses %I");
+
+    // IPv4 against inet_pton, from a string and from stdin
+    int bad = 0;
+    for (size_t i = 0; i < sizeof(ipv4_cases) / sizeof(ipv4_cases[0]); i++) {
+        struct in_addr ref;
+        int ref_ok = inet_pton(AF_INET, ipv4_cases[i], &ref) == 1;
+        unsigned int got = 0;
+        char text[32];
+        snprintf(text, sizeof(text), "%s;", ipv4_cases[i]);
+        int ok = my_sscanf(text, "%I;", &got) == 1;
+        with_input(text, run_myscanf_ip);
+        if (ok != ref_ok || (ok && got != ntohl(ref.s_addr)) || (ip_ret == 1) != ref_ok || (ref_ok && ip_value != got)) {
+            printf("    %s: mine %d/%d inet_pton %d\n", ipv4_cases[i], ok, ip_ret, ref_ok);
+            bad++;
+        }
+    }
+    if (!bad) pass("IPv4 matches inet_pton");
+    else fail("IPv4 matches inet_pton");
+
+    // Random dotted quads
+    unsigned long long state = 12345;
+    bad = 0;
+    for (int i = 0; i < 1000; i++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        char text[32];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", (unsigned)(state & 0xFF), (unsigned)(state >> 8 & 0xFF),
+                 (unsigned)(state >> 16 & 0xFF), (unsigned)(state >> 24 & 0x1FF));
+        struct in_addr ref;
+        int ref_ok = inet_pton(AF_INET, text, &ref) == 1;
+        unsigned int got = 0;
+        int ok = my_sscanf(text, "%I", &got) == 1;
+        if (ok != ref_ok || (ok && got != ntohl(ref.s_addr))) bad++;
+    }
+    if (!bad) pass("random IPv4");
+    else fail("random IPv4");
+
+    bad = 0;
+    for (size_t i = 0; i < sizeof(ipv6_cases) / sizeof(ipv6_cases[0]); i++) {
+        unsigned char ref[16], got[16];
+        int ref_ok = inet_pton(AF_INET6, ipv6_cases[i], ref) == 1;
+        int ok = my_sscanf(ipv6_cases[i], "%lI", got) == 1;
+        if (ok != ref_ok || (ok && memcmp(got, ref, 16))) {
+            printf("    %s: mine %d inet_pton %d\n", ipv6_cases[i], ok, ref_ok);
+            bad++;
+        }
+    }
+    if (!bad) pass("IPv6 matches inet_pton");
+    else fail("IPv6 matches inet_pton");
+
+    unsigned int a = 0;
+    int port = 0;
+    int r = my_sscanf("src=10.1.2.3:8080", "src=%I:%d", &a, &port);
+    if (r == 2 && a == 0x0A010203 && port == 8080) pass("address then port");
+    else fail("address then port");
+
+    r = my_sscanf("ip 1.2.3.999", "ip %I", &a);
+    const my_scanf_error *e = my_scanf_last_error();
+    if (r == 0 && e->reason == MY_SCANF_ERR_INVALID && e->offset == 3) pass("bad octet at field start");
+    else fail("bad octet at field start");
+}
+
+/* =========================
+   BULK NUMERIC INPUT
+   ========================= */
+// Writes n random numbers (ints, or doubles in two precisions) with mixed
+// separators to a growing buffer; returns it, with the length in *len.
+static char *bulk_text(int n, int doubles, size_t *len) {
+    size_t cap = (size_t)n * 28 + 1, used = 0;
+    char *text = malloc(cap);
+    unsigned long long state = 0x2545F4914F6CDD1DULL;
+    for (int i = 0; i < n; i++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        const char *sep = (i % 7 == 6) ? "\n" : (i % 3 == 0) ? ", " : ",";
+        if (!doubles) used += snprintf(text + used, cap - used, "%lld%s", (long long)state >> (state % 60), sep);
+        else if (i % 2) used += snprintf(text + used, cap - used, "%.6f%s", (double)(long long)(state >> 20) / 1e6 - 5e6, sep);
+        else used += snprintf(text + used, cap - used, "%.17g%s", (double)(state >> 11) * 0x1p-40, sep);
+    }
+    *len = used;
+    return text;
+}
+
+// Reference values via strtoll / strtod, reading the same separators.
+static size_t bulk_reference(const char *text, int doubles, void *out) {
+    size_t n = 0;
+    const char *p = text;
+    for (;;) {
+        while (*p == ',' || *p == ' ' || *p == '\n') p++;
+        if (!*p) return n;
+        char *next;
+        if (doubles) ((double *)out)[n++] = strtod(p, &next);
+        else ((long long *)out)[n++] = strtoll(p, &next, 10);
+        p = next;
+    }
+}
+
+void test_bulk_random(int doubles, int threads) {
+    size_t len, cap = 0;
+    int n = 700000;                     // Over one stream block
+    char *text = bulk_text(n, doubles, &len);
+    void *expected = malloc((size_t)n * 8), *got = NULL;
+    size_t ref = bulk_reference(text, doubles, expected);
+
+    my_scan_set_threads(threads);
+    FILE *fp = tmpfile();
+    fwrite(text, 1, len, fp);
+    rewind(fp);
+    size_t from_file = doubles ? my_scan_doubles(fp, (double **)&got, &cap, ',')
+                               : my_scan_int64s(fp, (long long **)&got, &cap, ',');
+    int ok = from_file == ref && my_scanf_last_error()->reason == MY_SCANF_OK;
+    for (size_t i = 0; ok && i < ref; i++) {
+        if (!doubles) ok = ((long long *)got)[i] == ((long long *)expected)[i];
+        else {
+            double a = ((double *)got)[i], b = ((double *)expected)[i];
+            ok = fabs(a - b) <= fabs(b) * 1e-15;
+            if (ok && i % 2) ok = a == b;               // %.6f values take the exact path
+        }
+        if (!ok) printf("    value %zu differs\n", i);
+    }
+    fclose(fp);
+
+    memset(got, 0, cap * 8);
+    size_t from_mem = doubles ? my_scan_doubles_mem(text, len, (double **)&got, &cap, ',')
+                              : my_scan_int64s_mem(text, len, (long long **)&got, &cap, ',');
+    ok = ok && from_mem == ref && !memcmp(got, expected, doubles ? 0 : ref * 8);
+    my_scan_set_threads(1);
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s x%d, %d thread%s", doubles ? "doubles" : "int64s", n, threads, threads > 1 ? "s" : "");
+    if (ok) pass(label);
+    else { printf("    got %zu / %zu values, expected %zu\n", from_file, from_mem, ref); fail(label); }
+    free(text);
+    free(expected);
+    free(got);
+}
+
+void test_bulk(void) {
+    print_section("Testing bulk numeric input");
+
+    long long *v = NULL;
+    size_t cap = 0;
+    const char *text = "1 -2,3\n +4 ,5,\n";
+    size_t n = my_scan_int64s_mem(text, strlen(text), &v, &cap, ',');
+    if (n == 5 && v[0] == 1 && v[1] == -2 && v[2] == 3 && v[3] == 4 && v[4] == 5 &&
+        my_scanf_last_error()->reason == MY_SCANF_OK) pass("separators");
+    else fail("separators");
+
+    text = "1 2\n x 4";
+    n = my_scan_int64s_mem(text, strlen(text), &v, &cap, 0);
+    const my_scanf_error *e = my_scanf_last_error();
+    if (n == 2 && e->reason == MY_SCANF_ERR_NO_DIGITS && e->offset == 5 && e->line == 2 && e->conversion == 2)
+        pass("malformed value");
+    else fail("malformed value");
+
+    text = "7 12ab 3";
+    n = my_scan_int64s_mem(text, strlen(text), &v, &cap, 0);
+    if (n == 1 && my_scanf_last_error()->reason == MY_SCANF_ERR_INVALID) pass("trailing garbage");
+    else fail("trailing garbage");
+
+    text = "5 9223372036854775808 -9223372036854775809 -9223372036854775808 123456789012345678901";
+    n = my_scan_int64s_mem(text, strlen(text), &v, &cap, 0);
+    e = my_scanf_last_error();
+    if (n == 5 && v[1] == LLONG_MAX && v[2] == LLONG_MIN && v[3] == LLONG_MIN && v[4] == LLONG_MAX &&
+        e->reason == MY_SCANF_ERR_OVERFLOW && e->conversion == 1 && e->offset == 2)
+        pass("int64 saturation");
+    else fail("int64 saturation");
+
+    double *d = NULL;
+    size_t dcap = 0;
+    text = "0.5 -1e3 2.5E-3 .25 7. 1e400";
+    n = my_scan_doubles_mem(text, strlen(text), &d, &dcap, 0);
+    if (n == 6 && d[0] == 0.5 && d[1] == -1000 && d[2] == 0.0025 && d[3] == 0.25 && d[4] == 7 && isinf(d[5]))
+        pass("double forms");
+    else fail("double forms");
+
+    text = "1.5 2e 3";
+    n = my_scan_doubles_mem(text, strlen(text), &d, &dcap, 0);
+    if (n == 1 && my_scanf_last_error()->reason == MY_SCANF_ERR_NO_DIGITS) pass("bad exponent");
+    else fail("bad exponent");
+
+    // Caller-provided storage is kept until it is too small
+    long long *sp = malloc(2 * sizeof(long long));
+    size_t scap = 2;
+    text = "1 2 3 4 5";
+    n = my_scan_int64s_mem(text, strlen(text), &sp, &scap, 0);
+    if (n == 5 && scap >= 5 && sp[4] == 5) pass("grows output");
+    else fail("grows output");
+
+    free(v);
+    free(d);
+    free(sp);
+
+    test_bulk_random(0, 1);
+    test_bulk_random(1, 1);
+    test_bulk_random(0, 4);
+}
+
+/* =========================
+   ERROR REPORTING
+   ========================= */
+static const char *err_format;
+static int err_ret;
+static const my_scanf_error *err_rec;
+
+void run_myscanf_error(void) {
+    long long a = 0, b = 0, c = 0;     // Wide enough for %lld / %lf targets
+    err_ret = my_scanf(err_format, &a, &b, &c);
+    err_rec = my_scanf_last_error();
+}
+
+void test_error_case(const char *label, const char *format, const char *input,
+                     int expected_ret, int reason, long long offset, long long line, int conversion) {
+    err_format = format;
+    with_input(input, run_myscanf_error);
+    if (err_ret == expected_ret && err_rec->reason == reason &&
+        err_rec->offset == offset && err_rec->line == line &&
+        err_rec->conversion == conversion) pass(label);
+    else {
+        printf("    input: '%s' format: '%s'\n", input, format);
+        printf("    got ret=%d reason=%d offset=%lld line=%lld conversion=%d\n",
+               err_ret, err_rec->reason, err_rec->offset, err_rec->line, err_rec->conversion);
+        printf("    expected ret=%d reason=%d offset=%lld line=%lld conversion=%d\n",
+               expected_ret, reason, offset, line, conversion);
+        fail(label);
+    }
+}
+
+void test_errors(void) {
+    print_section("Testing error reporting");
+    test_error_case("no error", "%d", "42\n", 1, MY_SCANF_OK, 0, 0, 0);
+    test_error_case("no digits", "%d %d", "12 abc\n", 1, MY_SCANF_ERR_NO_DIGITS, 3, 1, 1);
+    test_error_case("line number", "%d %d %d", "1\n2\nx\n", 2, MY_SCANF_ERR_NO_DIGITS, 4, 3, 2);
+    test_error_case("literal mismatch", "%d;%d", "5,6\n", 1, MY_SCANF_ERR_LITERAL, 1, 1, 1);
+    test_error_case("eof", "%d %d", "7", 1, MY_SCANF_ERR_EOF, 1, 1, 1);
+    test_error_case("malformed exponent", "%lf", "1e+\n", 0, MY_SCANF_ERR_EXPONENT, 3, 1, 0);
+    test_error_case("overflow saturated", "%lld", "99999999999999999999\n", 1, MY_SCANF_ERR_OVERFLOW, 0, 1, 0);
+    test_error_case("invalid boolean", "%B", "maybe\n", 0, MY_SCANF_ERR_INVALID, 0, 1, 0);
+}
+
+/* =========================
+   RECOVERY MODE
+   ========================= */
+static char rec_pairs[128];
+static char *rec_sink_buf;
+static size_t rec_sink_len;
+static long long rec_rejected;
+
+void run_myscanf_recovery(void) {
+    FILE *sink = open_memstream(&rec_sink_buf, &rec_sink_len);
+    int a, b, len = 0;
+    rec_pairs[0] = '\0';
+    my_scanf_set_recovery(1, sink);
+    while (my_scanf("%d %d", &a, &b) == 2)
+        len += snprintf(rec_pairs + len, sizeof(rec_pairs) - len, "(%d,%d)", a, b);
+    rec_rejected = my_scanf_rejected();
+    my_scanf_set_recovery(0, NULL);
+    fclose(sink);
+}
+
+void test_recovery_case(const char *label, const char *input, const char *pairs,
+                        long long rejected, const char *rejects) {
+    with_input(input, run_myscanf_recovery);
+    if (strcmp(rec_pairs, pairs) == 0 && rec_rejected == rejected &&
+        strcmp(rec_sink_buf, rejects) == 0) pass(label);
+    else {
+        printf("    got pairs=%s rejected=%lld sink='%s'\n", rec_pairs, rec_rejected, rec_sink_buf);
+        printf("    expected pairs=%s rejected=%lld sink='%s'\n", pairs, rejected, rejects);
+        fail(label);
+    }
+    free(rec_sink_buf);
+    rec_sink_buf = NULL;
+}
+
+void test_recovery(void) {
+    print_section("Testing recovery mode");
+    test_recovery_case("clean input", "1 2\n3 4\n", "(1,2)(3,4)", 0, "");
+    test_recovery_case("bad first field", "1 2\nx 3\n4 5\n", "(1,2)(4,5)", 1, "x 3\n");
+    test_recovery_case("bad second field", "7 y\n8 9\n", "(8,9)", 1, "7 y\n");
+    test_recovery_case("consecutive bad rows", "a\nb b\n1 1\n", "(1,1)", 2, "a\nb b\n");
+    test_recovery_case("bad last row", "1 2\nzz", "(1,2)", 1, "zz\n");
+}
+
+/* =========================
+   TABLE-DRIVEN CASES
+   ========================= */
+// Each case is a format, an input and the expected result, run through
+// my_sscanf. Results are rendered as text, "ret v1 v2 ...": the return
+// value, then every argument up to the last one assigned. An empty
+// `expected` means "whatever libc sscanf gives". Cases come from
+// CASES_FILE and from a generator, and run in shards on parallel threads
+// (TEST_JOBS overrides the thread count).
+#define CASES_FILE "test_cases.txt"
+#define GENERATED_CASES 200000
+#define MAX_SLOTS 8
+#define MAX_SHARDS 64
+
+typedef struct {
+    char format[64];
+    char input[192];
+    char expected[256];
+    int line;                   // Line in CASES_FILE (0 for generated cases)
+} table_case;
+
+typedef struct {
+    char spec;
+    char length[3];
+    int width;
+} slot_type;
+
+typedef union { long long ll; long double ld; void *ptr; char text[128]; } scan_slot;
+
+// Reads a value of `type` out of a slot without breaking aliasing rules.
+#define SLOT_AS(type, v) (*(type *)memcpy(&(type){0}, (v), sizeof(type)))
+
+// Types of the arguments `format` takes, in order. Returns their number.
+static int format_slots(const char *format, slot_type *types) {
+    int n = 0;
+    for (const char *p = format; *p; p++) {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+        int suppress = *p == '*';
+        p += suppress;
+        slot_type t = { 0 };
+        while (*p == 'q' || (*p >= '0' && *p <= '9')) {
+            if (*p != 'q') t.width = t.width * 10 + (*p - '0');
+            p++;
+        }
+        for (int k = 0; *p && strchr("hljztL", *p) && k < 2; k++) t.length[k] = *p++;
+        if (!(t.spec = *p)) break;
+        if (t.spec == '[') {
+            p += 1 + (p[1] == '^');
+            p += (p[1] == ']');
+            while (p[1] && p[1] != ']') p++;
+            if (!*++p) break;
+        }
+        if (!suppress && n < MAX_SLOTS) types[n++] = t;
+    }
+    return n;
+}
+
+static int render_slot(char *out, size_t cap, const slot_type *t, const scan_slot *v) {
+    const char *len = t->length;
+    switch (t->spec) {
+    case 'd': case 'i': case 'b': case 'B': case 'n':
+        if (!strcmp(len, "hh")) return snprintf(out, cap, "%d", SLOT_AS(signed char, v));
+        if (!strcmp(len, "h"))  return snprintf(out, cap, "%d", SLOT_AS(short, v));
+        if (!*len)              return snprintf(out, cap, "%d", SLOT_AS(int, v));
+        if (!strcmp(len, "l"))  return snprintf(out, cap, "%ld", SLOT_AS(long, v));
+        return snprintf(out, cap, "%lld", SLOT_AS(long long, v));
+    case 'u': case 'o': case 'x': case 'X':
+        if (!strcmp(len, "hh")) return snprintf(out, cap, "%u", SLOT_AS(unsigned char, v));
+        if (!strcmp(len, "h"))  return snprintf(out, cap, "%u", SLOT_AS(unsigned short, v));
+        if (!*len)              return snprintf(out, cap, "%u", SLOT_AS(unsigned, v));
+        if (!strcmp(len, "l"))  return snprintf(out, cap, "%lu", SLOT_AS(unsigned long, v));
+        return snprintf(out, cap, "%llu", SLOT_AS(unsigned long long, v));
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        if (!*len) return snprintf(out, cap, "%.9g", SLOT_AS(float, v));
+        if (!strcmp(len, "L")) return snprintf(out, cap, "%.21Lg", SLOT_AS(long double, v));
+        return snprintf(out, cap, "%.15g", SLOT_AS(double, v));   // scan_float may be a few ulps off
+    case 's': case '[': case 'D':
+        return snprintf(out, cap, "[%s]", v->text);
+    case 'c':
+        return snprintf(out, cap, "[%.*s]", t->width ? t->width : 1, v->text);
+    case 'p':
+        return snprintf(out, cap, "%p", v->ptr);
+    case 'T':
+        return snprintf(out, cap, "%lld", v->ll);
+    case 'I':
+        if (!*len) return snprintf(out, cap, "%08x", SLOT_AS(unsigned, v));
+        int n = 0;
+        for (int k = 0; k < 16; k++) n += snprintf(out + n, cap > (size_t)n ? cap - n : 0, "%02x", (unsigned char)v->text[k]);
+        return n;
+    default:
+        return snprintf(out, cap, "?");
+    }
+}
+
+// Scans input with format through my_sscanf (or libc sscanf) and writes the
+// rendered result to out.
+static void render_scan(char *out, size_t cap, const char *format, const char *input, int libc) {
+    slot_type types[MAX_SLOTS];
+    scan_slot v[MAX_SLOTS];
+    int slots = format_slots(format, types);
+    memset(v, 0, sizeof(v));
+    int ret = libc ? sscanf(input, format, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7])
+                   : my_sscanf(input, format, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+
+    size_t len = snprintf(out, cap, "%d", ret);
+    for (int i = 0, assigned = 0; i < slots && assigned < ret && len + 1 < cap; i++) {
+        out[len++] = ' ';
+        len += render_slot(out + len, cap - len, &types[i], &v[i]);
+        assigned += types[i].spec != 'n';
+    }
+    if (len >= cap) out[cap - 1] = '\0';
+}
+
+// Decodes \n, \t, \r, \\ and \xHH in place.
+static void unescape(char *s) {
+    char *out = s;
+    for (; *s; s++) {
+        if (*s != '\\' || !s[1]) { *out++ = *s; continue; }
+        switch (*++s) {
+        case 'n': *out++ = '\n'; break;
+        case 't': *out++ = '\t'; break;
+        case 'r': *out++ = '\r'; break;
+        case 'x': {
+            const char *hex = "0123456789abcdef";
+            int byte = 0;
+            for (int k = 0; k < 2 && s[1] && strchr(hex, s[1] | 0x20); k++, s++)
+                byte = byte * 16 + (int)(strchr(hex, s[1] | 0x20) - hex);
+            *out++ = (char)byte;
+            break;
+        }
+        default: *out++ = *s; break;
+        }
+    }
+    *out = '\0';
+}
+
+// Reads CASES_FILE: one case per line, "format<TAB>input<TAB>expected" with
+// C-style escapes in the first two fields; "libc" as expected compares with
+// sscanf. Blank lines and lines starting with '#' are skipped.
+// Returns the number of cases, or -1 if the file cannot be read.
+static int load_cases(const char *path, table_case **cases) {
+    FILE *in = fopen(path, "r");
+    if (!in) return -1;
+    char line[1024];
+    int n = 0, cap = 0, line_no = 0;
+    *cases = NULL;
+    while (fgets(line, sizeof(line), in)) {
+        line_no++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        char *format = line, *input = strchr(format, '\t'), *expected = input ? strchr(input + 1, '\t') : NULL;
+        if (!expected) {
+            printf("    %s:%d: expected three tab-separated fields\n", path, line_no);
+            continue;
+        }
+        *input++ = '\0';
+        *expected++ = '\0';
+        if (n == cap) *cases = realloc(*cases, (cap = cap ? cap * 2 : 256) * sizeof(table_case));
+        table_case *tc = &(*cases)[n++];
+        unescape(format);
+        unescape(input);
+        snprintf(tc->format, sizeof(tc->format), "%.63s", format);
+        snprintf(tc->input, sizeof(tc->input), "%.191s", input);
+        snprintf(tc->expected, sizeof(tc->expected), "%.255s", strcmp(expected, "libc") ? expected : "");
+        tc->line = line_no;
+    }
+    fclose(in);
+    return n;
+}
+
+// splitmix64: case i always gets the same random stream.
+static unsigned long long case_random(unsigned long long *state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Appends one random field of the given kind to *p.
+static void gen_field(char **p, const char *end, char kind, unsigned long long *state) {
+    unsigned long long r = case_random(state);
+    int room = (int)(end - *p);
+    switch (kind) {
+    case 'd': *p += snprintf(*p, room, "%d", (int)r); break;
+    case 'h': *p += snprintf(*p, room, "%d", (short)r); break;
+    case 'c': *p += snprintf(*p, room, "%d", (signed char)r); break;
+    case 'L': *p += snprintf(*p, room, "%lld", (long long)r >> (r % 64)); break;
+    case 'u': *p += snprintf(*p, room, "%u", (unsigned)r >> (r % 32)); break;
+    case 'x': *p += snprintf(*p, room, r & 1 ? "%x" : "0x%X", (unsigned)(r >> 8) >> (r % 32)); break;
+    case 'o': *p += snprintf(*p, room, "%o", (unsigned)(r >> 8) >> (r % 32)); break;
+    case 'i': *p += snprintf(*p, room, r % 3 == 0 ? "%d" : r % 3 == 1 ? "0x%x" : "0%o", (int)(r >> 8) & 0x7FFFFFF); break;
+    case 'f': {
+        // Up to 15 significant digits, sometimes with an exponent
+        long long mantissa = (long long)(r >> 14) % 1000000000000000LL;
+        int decimals = (int)(r % 8), digits = snprintf(*p, room, "%s%lld", r & 0x100 ? "-" : "", mantissa);
+        if (decimals > 0 && decimals < digits) {
+            memmove(*p + digits - decimals + 1, *p + digits - decimals, decimals + 1);
+            (*p)[digits - decimals] = '.';
+            digits++;
+        }
+        *p += digits;
+        if (r & 0x200) *p += snprintf(*p, end - *p, "e%d", (int)(r >> 40) % 40 - 20);
+        break;
+    }
+    case 'w':
+        for (int n = 1 + (int)(r % 12); n > 0 && *p < end - 1; n--)
+            *(*p)++ = 'a' + (int)(case_random(state) % 26);
+        **p = '\0';
+        break;
+    }
+}
+
+// Generated cases: each template is a format and the kinds of its fields.
+// Every field is well formed; 1 in 16 cases then gets one byte replaced by
+// a character that cannot continue a number, to exercise the failure paths.
+// (Digits, signs, whitespace and exponent letters are left out: an
+// out-of-range value saturates in my_scanf but wraps in glibc, and "1e"
+// without exponent digits is an error in my_scanf, so the byte after "e",
+// "e+" or "e-" is never replaced either; those cases differ by design.)
+static const struct { const char *format, *fields; } templates[] = {
+    { "%d%n", "d" },        { "%hd %hhd", "hc" },   { "%lld%n", "L" },
+    { "%u%n", "u" },        { "%x%n", "x" },        { "%o%n", "o" },
+    { "%i %i%n", "ii" },    { "%lf%n", "f" },       { "%f%n", "f" },
+    { "%3d%2d%n", "d" },    { "%s %d%n", "wd" },    { "%5s%n", "w" },
+    { "%[a-z]%d", "wd" },   { "%c%c%n", "w" },      { "%d,%d,%d", "ddd" },
+    { "%*d %d%n", "dd" },   { "%lld %lf %s", "Lfw" }, { "%lx:%lu", "xu" },
+};
+
+static const char noise[] = "!#$&()*;<=>?@[]^_{|}~ghkmqrvwyzGHKMQRVWYZ/";
+
+static void generate_case(int index, table_case *tc) {
+    unsigned long long state = (unsigned long long)index;
+    unsigned long long r = case_random(&state);
+    int t = (int)(r % (sizeof(templates) / sizeof(templates[0])));
+    char *p = tc->input, *end = tc->input + sizeof(tc->input) - 8;
+
+    snprintf(tc->format, sizeof(tc->format), "%s", templates[t].format);
+    for (const char *kind = templates[t].fields; *kind; kind++) {
+        if (r >> 8 & 1) *p++ = ' ';                     // Leading whitespace
+        gen_field(&p, end, *kind, &state);
+        *p++ = kind[1] ? (strchr(tc->format, ',') ? ',' : strchr(tc->format, ':') ? ':' : ' ') : '\n';
+        r >>= 1;
+    }
+    *p = '\0';
+    size_t len = p - tc->input;
+    size_t at = len ? case_random(&state) % len : 0;
+    size_t mark = at > 0 && (tc->input[at - 1] == '-' || tc->input[at - 1] == '+') ? at - 1 : at;
+    if ((case_random(&state) & 15) == 0 && len > 0 && (mark == 0 || (tc->input[mark - 1] | 0x20) != 'e'))
+        tc->input[at] = noise[case_random(&state) % (sizeof(noise) - 1)];
+    tc->expected[0] = '\0';
+    tc->line = 0;
+}
+
+typedef struct {
+    const table_case *cases;    // NULL: generate the cases
+    int count, shard, shards;
+    int passed, failed;
+    char failures[4][640];      // First few mismatches of this shard
+} table_shard;
+
+static void *run_shard(void *arg) {
+    table_shard *sh = arg;
+    for (int i = sh->shard; i < sh->count; i += sh->shards) {
+        table_case generated;
+        const table_case *tc = sh->cases ? &sh->cases[i] : &generated;
+        if (!sh->cases) generate_case(i, &generated);
+
+        char got[256], want[256];
+        render_scan(got, sizeof(got), tc->format, tc->input, 0);
+        if (tc->expected[0]) snprintf(want, sizeof(want), "%s", tc->expected);
+        else render_scan(want, sizeof(want), tc->format, tc->input, 1);
+
+        if (strcmp(got, want) == 0) sh->passed++;
+        else if (sh->failed++ < 4)
+            snprintf(sh->failures[sh->failed - 1], sizeof(sh->failures[0]),
+                     "%s %d: format \"%s\" input \"%s\": got \"%.120s\", expected \"%.120s\"",
+                     tc->line ? "line" : "case", tc->line ? tc->line : i, tc->format, tc->input, got, want);
+    }
+    my_scanf_thread_cleanup();
+    return NULL;
+}
+
+static int test_jobs(void) {
+    const char *env = getenv("TEST_JOBS");
+    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : n > MAX_SHARDS ? MAX_SHARDS : (int)n;
+}
+
+// Runs count cases (from `cases`, or generated when NULL) on parallel shards.
+static void run_table(const char *label, const table_case *cases, int count) {
+    int jobs = test_jobs(), passed = 0, failed = 0;
+    table_shard sh[MAX_SHARDS];
+    pthread_t tid[MAX_SHARDS];
+    for (int j = 0; j < jobs; j++) {
+        sh[j] = (table_shard){ .cases = cases, .count = count, .shard = j, .shards = jobs };
+        if (pthread_create(&tid[j], NULL, run_shard, &sh[j]) != 0) { perror("pthread_create"); exit(1); }
+    }
+    for (int j = 0; j < jobs; j++) {
+        pthread_join(tid[j], NULL);
+        passed += sh[j].passed;
+        failed += sh[j].failed;
+        for (int k = 0; k < sh[j].failed && k < 4; k++) printf("    %s\n", sh[j].failures[k]);
+    }
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%s: %d/%d cases on %d thread%s", label, passed, count, jobs, jobs > 1 ? "s" : "");
+    if (failed == 0) pass(msg);
+    else fail(msg);
+}
+
+void test_table(void) {
+    print_section("Testing table-driven cases");
+    table_case *cases;
+    int n = load_cases(CASES_FILE, &cases);
+    if (n < 0) {
+        printf("    cannot read %s (run from the source directory)\n", CASES_FILE);
+        fail(CASES_FILE);
+    } else {
+        run_table(CASES_FILE, cases, n);
+        free(cases);
+    }
+    run_table("generated", NULL, GENERATED_CASES);
+}
+
+/* =========================
+   FAST PATHS
+   ========================= */
+// A %d / %u / %f without a width goes through the adaptive fast path; the
+// same conversion with a wide width always takes the general path. Both
+// must agree on the value, the return and the bytes consumed.
+static const char *fast_inputs[] = {
+    "42", "  7\n", "\n\n123 ", "0", "00012", "-5", "+3", "-", "x", "", "   ",
+    "18446744073709551616", "99999999999999999999999", "4294967296", "2147483648",
+    "3.25", "-0.5", ".5", "5.", "-.5", "-x", "1e3", "1.5E-2x", "1e", "0x1.8p3", "0x",
+    "123456789012345", "1234567890123456", "0.000000000000001", "-0", "12abc", "7,8",
+};
+
+static const char *fast_formats[][2] = {
+    { "%d%n", "%40d%n" }, { "%u%n", "%40u%n" }, { "%hhd%n", "%40hhd%n" }, { "%lld%n", "%40lld%n" },
+    { "%lf%n", "%40lf%n" }, { "%f%n", "%40f%n" }, { "%Lf%n", "%40Lf%n" },
+};
+
+static const char *fast_format;
+static conv_slot fast_v;
+static int fast_r, fast_n;
+
+void run_myscanf_fast(void) { memset(&fast_v, 0, sizeof(fast_v)); fast_n = -1; fast_r = my_scanf(fast_format, &fast_v, &fast_n); }
+
+void test_fast_equivalence(void) {
+    int bad = 0, total = 0;
+    for (size_t f = 0; f < sizeof(fast_formats) / sizeof(fast_formats[0]); f++) {
+        for (size_t i = 0; i < sizeof(fast_inputs) / sizeof(fast_inputs[0]); i++) {
+            const char *input = fast_inputs[i];
+            conv_slot results[4];
+            int rets[4], ns[4];
+            for (int k = 0; k < 2; k++) {
+                // String source
+                memset(&results[k], 0, sizeof(conv_slot));
+                ns[k] = -1;
+                rets[k] = my_sscanf(input, fast_formats[f][k], &results[k], &ns[k]);
+                // Stream source
+                fast_format = fast_formats[f][k];
+                with_input(input, run_myscanf_fast);
+                results[2 + k] = fast_v;
+                rets[2 + k] = fast_r;
+                ns[2 + k] = fast_n;
+            }
+            for (int k = 0; k < 4; k += 2) {
+                total++;
+                if (rets[k] != rets[k + 1] || ns[k] != ns[k + 1] || !conv_equal(fast_formats[f][0], &results[k], &results[k + 1])) {
+                    printf("    %s '%s' (%s): fast ret=%d n=%d, general ret=%d n=%d\n", fast_formats[f][0], input,
+                           k ? "stdin" : "string", rets[k], ns[k], rets[k + 1], ns[k + 1]);
+                    bad++;
+                }
+            }
+        }
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "fast and general paths agree (%d cases)", total);
+    if (bad == 0) pass(label);
+    else fail(label);
+}
+
+void test_fast_adaptive(void) {
+    // Fresh arrays, so the directives start with no history from other tests
+    char format[] = "%d", signed_format[] = "%d";
+    int v = 0, ok = 1;
+
+    my_scanf_reset_stats();
+    for (int i = 0; i < 100; i++) ok &= my_sscanf("12", format, &v) == 1 && v == 12;
+    const my_scanf_stats *st = my_scanf_get_stats();
+    if (ok && st->fast == 100 && st->fallback == 0 && st->demotions == 0) pass("plain digits take the fast path");
+    else fail("plain digits take the fast path");
+
+    // Signed fields miss the shape: the directive is demoted after one window
+    my_scanf_reset_stats();
+    for (int i = 0; i < 200; i++) ok &= my_sscanf("-3", signed_format, &v) == 1 && v == -3;
+    if (ok && st->demotions == 1 && st->fallback == 64 && st->general == 136) pass("signed fields demote the directive");
+    else {
+        printf("    fast=%llu fallback=%llu general=%llu demotions=%llu\n", st->fast, st->fallback, st->general, st->demotions);
+        fail("signed fields demote the directive");
+    }
+
+    // ...and it tries the fast path again once the rest is over
+    for (int i = 0; i < 4096; i++) ok &= my_sscanf("8", signed_format, &v) == 1 && v == 8;
+    if (ok && st->promotions == 1 && st->fast > 0) pass("demoted directive is promoted again");
+    else fail("demoted directive is promoted again");
+}
+
+void test_fast_paths(void) {
+    print_section("Testing adaptive fast paths");
+    test_fast_equivalence();
+    test_fast_adaptive();
+}
+
 /* =========================
    MAIN
    ========================= */
 int main(void){
     test_integers();
+    test_saturation();
     test_hex();
     test_binary();
     test_strings();
@@ -479,6 +2518,25 @@ int main(void){
     test_floats();
     test_percent();
     test_multi_fields();
+    test_conversions();
+    test_scansets();
+    test_utf8();
+    test_lookahead();
+    test_sscanf();
+    test_lines();
+    test_compressed();
+    test_checkpoints();
+    test_sink();
+    test_csv();
+    test_custom();
+    test_long_fields();
+    test_timestamps();
+    test_addresses();
+    test_bulk();
+    test_errors();
+    test_recovery();
+    test_fast_paths();
+    test_table();
     printf("\nTests passed %d/%d\n",tests_passed,tests_run);
-    return 0;
+    return tests_passed == tests_run ? 0 : 1;
 }